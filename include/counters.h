@@ -0,0 +1,117 @@
+#ifndef INCLUDE_COUNTERS_H_
+#define INCLUDE_COUNTERS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gbolt {
+
+//! Phases of a run measured by hardware counters.
+enum counter_phase_t {
+  PHASE_READ,
+  PHASE_CONSTRUCT,
+  PHASE_PROJECT,
+  PHASE_ENUMERATE,
+  PHASE_IS_MIN,
+  PHASE_REPORT,
+  NPHASES
+};
+
+//! Hardware events counted in every phase.
+enum counter_event_t {
+  EVENT_CYCLES,
+  EVENT_INSTRUCTIONS,
+  EVENT_LLC_MISSES,
+  EVENT_BRANCH_MISSES,
+  NEVENTS
+};
+
+/*!
+PerfCounters are the hardware counters of a single thread, opened with
+perf_event_open as one group, so that all events are scheduled together.
+They are opened by the first phase begun on their thread, and phases are
+not counted if they cannot be opened. Counts are attributed to the innermost
+phase begun on the thread: a phase running inside another one, e.g. a task
+scheduled while enumerate waits for its chunks, is not counted twice. Counts
+are scaled when the kernel multiplexes the group.
+*/
+class PerfCounters {
+ public:
+  PerfCounters();
+
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters& operator=(const PerfCounters &) = delete;
+
+  /*!
+  Opens the counters of the calling thread. Returns false with the reason in
+  error if even cycles cannot be counted, e.g. in a container without access
+  to perf events. Other events missing on the hardware are left out.
+  */
+  bool open(std::string &error);
+
+  bool opened() const { return fds_[EVENT_CYCLES] != -1; }
+
+  //! True iff event could be opened.
+  bool available(int event) const { return fds_[event] != -1; }
+
+  void begin(counter_phase_t phase);
+
+  void end();
+
+  //! Scaled count of event in phase.
+  uint64_t count(int phase, int event) const { return counts_[phase][event]; }
+
+  //! Number of times phase was begun.
+  uint64_t calls(int phase) const { return calls_[phase]; }
+
+ private:
+  // Reads the group and adds the counts since the last read to the innermost phase
+  void accumulate();
+
+ private:
+  bool attempted_;
+  int fds_[NEVENTS];
+  // Event of each value read from the group, in the order they were opened
+  std::vector<int> events_;
+  uint64_t last_[NEVENTS];
+  uint64_t last_enabled_;
+  uint64_t last_running_;
+  std::vector<counter_phase_t> phases_;
+  uint64_t counts_[NPHASES][NEVENTS];
+  uint64_t calls_[NPHASES];
+};
+
+/*!
+A PerfScope counts its lifetime as phase on counters, which may be null when
+counting is disabled.
+*/
+class PerfScope {
+ public:
+  PerfScope(PerfCounters *counters, counter_phase_t phase) : counters_(counters) {
+    if (counters_ != nullptr) {
+      counters_->begin(phase);
+    }
+  }
+
+  ~PerfScope() {
+    if (counters_ != nullptr) {
+      counters_->end();
+    }
+  }
+
+  PerfScope(const PerfScope &) = delete;
+  PerfScope& operator=(const PerfScope &) = delete;
+
+ private:
+  PerfCounters *counters_;
+};
+
+//! Name of phase, for reports.
+const char *counter_phase_name(int phase);
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_COUNTERS_H_
@@ -5,22 +5,26 @@
 #include <string>
 #include <unordered_map>
 
-#define FILE_MAX_LINE 1024
-
 namespace gbolt {
 
-class Graph;
+template <typename W>
+class BasicGraph;
 
 class Database {
  public:
-  // Return graph count
+  // Read graphs from a plain, gzip or zstd file, or from stdin for "-"
   void read_input(const std::string &input_file, const std::string &separator);
 
-  // Construct graph by frequent labels
+  // Construct graph by frequent labels, relabelled to their dense ids. Edges
+  // whose (from label, edge label, to label) triple is in fewer than
+  // triple_support graphs are dropped too, then vertices left without edges.
+  // Labels and vertex ids must fit the width W.
+  template <typename W>
   void construct_graphs(
-    const std::unordered_map<int, std::vector<int> > &frequent_vertex_labels,
-    const std::unordered_map<int, int> &frequent_edge_labels,
-    std::vector<Graph> &graphs);
+    const std::unordered_map<int, int> &vertex_label_ids,
+    const std::unordered_map<int, int> &edge_label_ids,
+    int triple_support,
+    std::vector<BasicGraph<W> > &graphs);
 
   struct input_vertex {
     int id, label;
@@ -32,9 +36,11 @@ class Database {
   };
   struct input_graph {
     int id;
+    // Optional class after the id on the t # line, 0 if missing
+    int graph_class;
     std::vector<input_vertex> vertices;
     std::vector<input_edge> edges;
-    input_graph(int i) : id(i) {}
+    input_graph(int i, int c) : id(i), graph_class(c) {}
   };
   const std::vector<input_graph>& get_graphs() const { return input_graphs_; }
  private:
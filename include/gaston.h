@@ -0,0 +1,145 @@
+#ifndef INCLUDE_GASTON_H_
+#define INCLUDE_GASTON_H_
+
+#include <graph.h>
+#include <unordered_set>
+#include <vector>
+#include <string>
+
+#ifndef GBOLT_SERIAL
+#include <omp.h>
+#endif
+
+namespace gbolt {
+
+// Undirected edge between two pattern vertices
+struct gaston_edge_t {
+  int from;
+  int to;
+  int label;
+};
+
+/*!
+A GastonPattern is a connected pattern grown one edge at a time by the Gaston
+engine. Vertices are numbered in the order they were added. Its canonical key
+depends on its shape: paths and free trees have cheap canonical forms, only
+cyclic patterns need a minimum DFS code.
+*/
+class GastonPattern {
+ public:
+  enum shape_t { PATH, TREE, CYCLIC };
+
+  shape_t shape() const;
+
+  //! Equal for two patterns iff they are isomorphic.
+  std::string key() const;
+
+  /*!
+  Whether a path or free tree is grown from the pattern with the given key by
+  its last vertex. Its canonical parent is left by removing one of its
+  peripheral leaves, those ending a longest path, with the least label and
+  edge label, and then the least key left, and the last vertex must be such
+  a leaf. Every path and free tree has a single canonical parent, so it is
+  mined once.
+  */
+  bool canonical_parent(const std::string &parent_key) const;
+
+  /*!
+  Whether a leaf added to each vertex of a path or free tree may be peripheral
+  in the grown pattern: the vertices whose eccentricity is at least the
+  diameter less one. Paths and free trees are only grown from those.
+  */
+  std::vector<bool> leaf_parents() const;
+
+  //! The minimum DFS code, which numbers the vertices canonically.
+  std::vector<wide_dfs_code_t> min_dfs_codes() const;
+
+  //! Dense labels of the vertices.
+  std::vector<int> labels;
+  std::vector<gaston_edge_t> edges;
+
+ private:
+  // Adjacent vertices and edge labels of each vertex
+  std::vector<std::vector<gaston_edge_t> > adjacency() const;
+
+  // Largest distance from each vertex of a path or free tree to another one
+  std::vector<int> eccentricities() const;
+
+  // The pattern with a vertex of degree one and its edge removed
+  GastonPattern without_leaf(int leaf) const;
+
+  // The smaller of the label sequence read from either end
+  std::string path_key() const;
+
+  // Tree rooted at its center, or at its central edge, with sorted children
+  std::string tree_key() const;
+
+  // Minimum DFS code
+  std::string cyclic_key() const;
+};
+
+// An extension frequent in the embeddings of a GastonPattern: an edge to a new
+// vertex, numbered after the others, or an edge closing a cycle, from the lower
+// pattern vertex to the higher one
+struct gaston_extension_t {
+  gaston_edge_t edge;
+  // Dense label of the new vertex, -1 if the edge closes a cycle
+  int to_label;
+  int nsupport;
+  int nembeddings;
+};
+
+// A frequent extension of an embedding, and the graph vertex it adds, -1 if it
+// closes a cycle
+struct gaston_occurrence_t {
+  int extension;
+  int vertex;
+};
+
+// Embeddings of a GastonPattern, one graph vertex per pattern vertex each,
+// ordered by graph, and the frequent extensions of every embedding: those of
+// embedding i are occurrences[offsets[i]] up to occurrences[offsets[i + 1]].
+// A child finds the extensions it inherits in the occurrences of its parent.
+struct gaston_projection_t {
+  std::vector<int> graph_ids;
+  std::vector<int> vertice;
+  std::vector<gaston_extension_t> extensions;
+  std::vector<int> offsets;
+  std::vector<gaston_occurrence_t> occurrences;
+};
+
+// Where the embeddings of a child of a GastonPattern are found: the extension
+// of the parent pattern it is, or -1 for a first edge, the parent embeddings it
+// occurs in, and the graph vertex it adds to each, -1 if it closes a cycle. Its
+// key is kept from the canonical checks, empty for a first edge.
+struct gaston_child_t {
+  int extension;
+  std::vector<int> parents;
+  std::vector<int> vertice;
+  std::string key;
+};
+
+// Canonical keys of the patterns found so far, shared by all threads
+class GastonKeys {
+ public:
+  GastonKeys();
+
+  ~GastonKeys();
+
+  GastonKeys(const GastonKeys &) = delete;
+  GastonKeys& operator=(const GastonKeys &) = delete;
+
+  //! Returns true iff key was not found before.
+  bool insert(const std::string &key);
+
+ private:
+  static const int nshards = 64;
+  std::unordered_set<std::string> shards_[nshards];
+  #ifndef GBOLT_SERIAL
+  omp_lock_t locks_[nshards];
+  #endif
+};
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_GASTON_H_
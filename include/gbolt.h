@@ -4,10 +4,17 @@
 #include <graph.h>
 #include <history.h>
 #include <output.h>
+#include <trace.h>
+#include <counters.h>
+#include <progress.h>
+#include <state.h>
+#include <gaston.h>
 #include <unordered_map>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
+#include <sstream>
 
 #ifndef GBOLT_SERIAL
 #include <omp.h>
@@ -17,15 +24,44 @@ namespace gbolt {
 
 class Database;
 
-struct gbolt_instance_t {
+template <typename W>
+struct basic_gbolt_instance_t {
+  using edge_t = basic_edge_t<W>;
+  using vertex_t = basic_vertex_t<W>;
+  using Graph = BasicGraph<W>;
+  using History = BasicHistory<W>;
+  using MinProjection = BasicMinProjection<W>;
+  using dfs_code_t = basic_dfs_code_t<W>;
+  using DfsCodes = BasicDfsCodes<W>;
+
   Graph min_graph;
+  // Undirected edges of min_graph, reused between builds
+  std::vector<edge_t> min_edges;
   History history;
   Output output;
+  Trace trace;
   std::vector<int> right_most_path;
   MinProjection min_projection;
-
-  gbolt_instance_t(int max_edges, int max_vertice, const std::string& output_file_thread)
-    : history(max_edges, max_vertice), output(output_file_thread) {}
+  // Frequent patterns collected instead of reported, for incremental mining
+  std::vector<pattern_t> patterns;
+
+  // Original labels of dense vertex and edge labels, used for output
+  const std::vector<int> &vertex_labels;
+  const std::vector<int> &edge_labels;
+  // Class of each graph, to output the supports per class, or null
+  const std::vector<int> *graph_classes = nullptr;
+  int nclasses = 0;
+  // Graphs collapsed into each graph, whose ids are output with it, or null
+  const std::vector<std::vector<int> > *duplicate_graphs = nullptr;
+  // Hardware counters of the thread using this instance, or null
+  PerfCounters *counters = nullptr;
+  // Progress counters of the thread using this instance, or null
+  progress_counter_t *progress = nullptr;
+
+  basic_gbolt_instance_t(int max_edges, int max_vertice, const std::string& output_file_thread,
+    const std::vector<int> &vertex_labels, const std::vector<int> &edge_labels)
+    : history(max_edges, max_vertice), output(output_file_thread),
+      vertex_labels(vertex_labels), edge_labels(edge_labels) {}
 
   //!@name Methods relating to determining if a DFS code sequence is minimal:
   ///@{
@@ -95,24 +131,403 @@ struct gbolt_instance_t {
   void report(const DfsCodes &dfs_codes, const Projection &projection,
     int nsupport, int prev_thread_id, int prev_graph_id);
 
+  /*!
+  Reports a given DFS code sequence as frequent, outputs the graph
+  and the given supporting graphs.
+  */
+  void report(const DfsCodes &dfs_codes, const std::vector<int> &graph_ids,
+    int nsupport, int prev_thread_id, int prev_graph_id);
+
+  /*!
+  Writes the vertices and edges of min_graph, which must already be built
+  from dfs_codes, into ss.
+  */
+  void report_pattern(const DfsCodes &dfs_codes, std::stringstream &ss);
+
+  /*!
+  Writes graph_ids into ss, with the graphs collapsed into each of them.
+  */
+  void report_graph_ids(const std::vector<int> &graph_ids, std::stringstream &ss);
+
+  /*!
+  Writes the number of supporting graphs of each class of projection into ss.
+  */
+  void report_classes(const Projection &projection, std::stringstream &ss);
+
+  /*!
+  Reports a given Gaston pattern as frequent, outputs the graph
+  and the graphs of all its embeddings.
+  */
+  void report(const GastonPattern &pattern, const gaston_projection_t &projection,
+    int nsupport, int prev_thread_id, int prev_graph_id);
+
+  /*!
+  Keeps a given DFS code sequence and the graphs of projection in patterns,
+  instead of reporting it.
+  */
+  void collect(const DfsCodes &dfs_codes, const Projection &projection);
+
   ///@}
 };
 
-class GBolt {
+// A node of the trie of query patterns, holding the last DFS code of a prefix
+// shared by the queries below it
+template <typename W>
+struct basic_query_node_t {
+  basic_dfs_code_t<W> code;
+  std::vector<int> children;
+  // Queries whose DFS codes end here
+  std::vector<int> queries;
+};
+
+/*!
+The options of a mining run and the state that does not depend on the width
+of labels and vertex ids: the dense labels, supports, classes and counters.
+GBolt reads the input into it, then moves it into the mining core of the
+width the input fits.
+*/
+class GBoltBase {
  public:
-  GBolt(const std::string &output_file, double support) :
-    output_file_(output_file), support_(support) {}
+  GBoltBase(const std::string &output_file, double support) :
+    output_file_(output_file), support_(support), trace_(false),
+    embedding_free_(false), embedding_threshold_(0.0), mni_support_(0),
+    border_(0.0), first_graph_(0), collect_(false), gaston_(false),
+    merge_output_(false), sample_(0.0), sample_delta_(0.0), sample_max_lowering_(0.0),
+    sample_seed_(0),
+    target_class_(-1), max_other_(1.0), min_score_(-1.0), collapse_duplicates_(false),
+    ncounters_(0), progress_interval_(0.0) {}
+
+  // Record every mining task for save_trace
+  void enable_trace() { trace_ = true; }
 
-  void read_input(const std::string &input_file, const std::string &separator);
+  /*!
+  Count cycles, instructions, last level cache misses and branch misses of
+  every thread in the read, construct, project, enumerate, is_min and report
+  phases, for report_counters. Must be called before read_input, on the same
+  thread. Returns false with the reason in error, leaving counting disabled,
+  if the counters cannot be opened, as in most containers.
+  */
+  bool enable_counters(std::string &error);
+
+  /*!
+  Mine without storing embeddings: patterns only keep their supporting graph
+  ids, and are re-embedded into each of them to find extensions. If always is
+  false, a subtree only switches to this mode once its pattern has more than
+  threshold embeddings per supporting graph (0 never switches).
+  */
+  void set_embedding_free(bool always, double threshold) {
+    embedding_free_ = always;
+    embedding_threshold_ = threshold;
+  }
+
+  /*!
+  Mine a single large graph: the input graphs are treated as the connected
+  components of one graph, and the support of a pattern is its minimum image
+  based support, the least number of distinct vertices any of its vertices is
+  mapped to. Patterns need a support of at least nsupport, the relative
+  support is ignored. Cannot be combined with embedding-free mining.
+  */
+  void set_mni(int nsupport) { mni_support_ = nsupport; }
+
+  /*!
+  Incremental mining: state_in is the state saved by an earlier run, whose
+  graphs must be the first graphs of the input. Only the graphs appended since
+  are mined, and the output is the same as mining all graphs. The state of this
+  run is saved to state_out, keeping every pattern with at least border
+  relative support for later runs. Either file may be empty. A border of 0
+  keeps the border of state_in, or is the support for a new state.
+  */
+  void set_incremental(const std::string &state_in, const std::string &state_out,
+    double border) {
+    state_in_ = state_in;
+    state_out_ = state_out;
+    border_ = border;
+  }
+
+  /*!
+  Save one output set per support, output_file.s<support>.t<thread>, each
+  holding the patterns with at least that support under the ids of the lowest
+  one. Mining must use the lowest support. One support keeps the plain files.
+  */
+  void set_output_supports(const std::vector<double> &supports) {
+    output_supports_ = supports;
+  }
+
+  /*!
+  Mine with the Gaston engine instead of gSpan: patterns grow one edge at a
+  time from their embeddings, paths before free trees before cyclic patterns,
+  and a pattern is only mined the first time its canonical key is found. Paths
+  and trees have cheap canonical keys, cyclic patterns use their minimum DFS
+  code. Finds the same patterns as gSpan, with other vertex ids and parents.
+  Cannot be combined with embedding-free, incremental or minimum image based
+  mining.
+  */
+  void set_gaston(bool gaston) { gaston_ = gaston; }
+
+  /*!
+  Save a single output file per support instead of one per thread. Patterns
+  get global ids in the order of their DFS codes, or of their canonical keys
+  with the Gaston engine, independent of the number of threads.
+  */
+  void set_merge_output(bool merge_output) { merge_output_ = merge_output; }
+
+  /*!
+  Approximate mining: mine a random fraction of the graphs, chosen by seed,
+  at the support s lowered by the relative Chernoff bound
+  sqrt(2 ln(1 / delta) / sn) for n sampled graphs, then count the exact
+  support of every candidate in all graphs. Reported patterns and supports are
+  exact, but each frequent pattern is missed with probability at most delta.
+  Small samples lower the support more and produce more candidates, so mining
+  fails if it is lowered by more than max_lowering, naming the sample size
+  delta needs.
+  A fraction of 0 mines all graphs.
+  Cannot be combined with embedding-free, incremental, minimum image based or
+  Gaston mining.
+  */
+  void set_sample(double fraction, double delta, double max_lowering, unsigned int seed) {
+    sample_ = fraction;
+    sample_delta_ = delta;
+    sample_max_lowering_ = max_lowering;
+    sample_seed_ = seed;
+  }
+
+  /*!
+  Query instead of mine: count the support of every pattern of query_file, in
+  the output format with patterns (-d), in the input graphs. The results are
+  saved like mined patterns, one per query in the order of query_file, with
+  the supporting graph ids. Queries share the embeddings of their common DFS
+  code prefixes. Cannot be combined with other mining modes.
+  */
+  void set_query(const std::string &query_file) { query_file_ = query_file; }
+
+  /*!
+  Discriminative mining of graphs tagged with classes on their t # lines. The
+  relative support is the one within target_class. Only patterns supported by
+  at most max_other of the graphs of the other classes, and whose relative
+  support in target_class exceeds the one in the others by min_score, are
+  reported, with their supports per class. A min_score of -1 keeps every
+  pattern max_other allows. The support in target_class bounds the score of
+  every descendant, so subtrees below min_score are pruned.
+  Parents are the nearest reported ancestors. A target class of -1 mines all
+  graphs alike.
+  */
+  void set_classes(int target_class, double max_other, double min_score) {
+    target_class_ = target_class;
+    max_other_ = max_other;
+    min_score_ = min_score;
+  }
+
+  /*!
+  Collapse isomorphic input graphs after reconstructing them: graphs are
+  grouped by a Weisfeiler-Lehman hash and an exact isomorphism test, and only
+  the first graph of a group is mined, counting as many graphs as the group.
+  Reported graph ids still list every graph. Cannot be combined with minimum
+  image based, incremental, Gaston, sampled or discriminative mining.
+  */
+  void set_collapse_duplicates(bool collapse) { collapse_duplicates_ = collapse; }
+
+  /*!
+  Report progress while mining from a monitor thread every interval seconds,
+  to the log or, if status_file is not empty, into that file. Mining threads
+  only update counters of their own, which the monitor reads. An interval of
+  0 reports nothing.
+  */
+  void set_progress(double interval, const std::string &status_file) {
+    progress_interval_ = interval;
+    progress_file_ = status_file;
+  }
+
+  // Log the counts, IPC and miss rates of every phase, summed over all threads
+  void report_counters() const;
+
+ protected:
+  bool incremental() const { return !state_in_.empty() || !state_out_.empty(); }
+
+  // Find frequent labels and assign their dense ids, after the labels of the
+  // loaded state
+  void find_frequent_nodes_and_edges(const Database& db,
+    std::unordered_map<int, int> &vertex_label_ids,
+    std::unordered_map<int, int> &edge_label_ids);
+
+  #ifdef GBOLT_SERIAL
+  constexpr static int thread_id() { return 0; }
+  #else
+  static int thread_id() { return omp_get_thread_num(); }
+  #endif
+
+  // Hardware counters of the calling thread, or null if not counting
+  PerfCounters *counters() const {
+    return counters_ ? &counters_[thread_id()] : nullptr;
+  }
+
+  // Count a mining task of a pattern with nedges edges for the monitor,
+  // spawned or finished by the calling thread
+  void progress_spawned(size_t nedges) const {
+    if (progress_) {
+      progress_counter_t &progress = progress_[thread_id()];
+      progress_add(progress.tasks_spawned);
+      if (nedges == 1) {
+        progress_add(progress.subtrees_spawned);
+      }
+    }
+  }
+
+  void progress_finished(size_t nedges) const {
+    if (progress_) {
+      progress_counter_t &progress = progress_[thread_id()];
+      progress_add(progress.tasks_finished);
+      if (nedges == 1) {
+        progress_add(progress.subtrees_finished);
+      }
+    }
+  }
+
+  // Count, weighted by the duplicates of each graph
+  int count_support(const std::vector<int> &graph_ids) const;
+
+  bool classes() const { return target_class_ >= 0; }
+
+  // Number of graphs of the target class and of the others supporting graph_ids
+  void count_classes(const std::vector<int> &graph_ids, int &ntarget, int &nother) const;
+
+  // True iff a pattern with these class supports is reported, see set_classes
+  bool discriminative(int ntarget, int nother) const;
+
+ protected:
+  // Frequent labels are renumbered to dense ids, vertex labels from the least
+  // to the most frequent one and edge labels the other way round. These map
+  // dense ids back to the original labels.
+  std::vector<int> frequent_vertex_labels_;
+  std::vector<int> frequent_edge_labels_;
+  // Graphs containing each frequent vertex label and its support, indexed by
+  // dense id
+  std::vector<std::vector<int> > frequent_vertex_graphs_;
+  std::vector<int> frequent_vertex_support_;
+  std::string output_file_;
+  double support_;
+  int nsupport_;
+  std::vector<double> output_supports_;
+  bool trace_;
+  bool embedding_free_;
+  double embedding_threshold_;
+  // Minimum image based support, 0 counts supporting graphs instead
+  int mni_support_;
+  // Global id of the first vertex of each graph, for minimum image based support
+  std::vector<size_t> vertex_offsets_;
+  // Incremental mining, see set_incremental
+  std::string state_in_;
+  std::string state_out_;
+  double border_;
+  state_t state_;
+  // Only graphs from this one on are projected
+  int first_graph_;
+  // Collect frequent patterns into the instances instead of reporting them
+  bool collect_;
+  bool gaston_;
+  bool merge_output_;
+  // Approximate mining, see set_sample
+  double sample_;
+  double sample_delta_;
+  double sample_max_lowering_;
+  unsigned int sample_seed_;
+  // Only graphs marked here are projected, all if empty
+  std::vector<bool> sampled_;
+  // Pattern queries, see set_query, and the graphs found for each query
+  std::string query_file_;
+  std::vector<std::vector<int> > query_graph_ids_;
+  // Discriminative mining, see set_classes
+  int target_class_;
+  double max_other_;
+  double min_score_;
+  std::vector<int> graph_classes_;
+  int ntarget_graphs_;
+  int nother_graphs_;
+  // Least support in the target class a pattern or its descendants need
+  int target_nsupport_;
+  // Duplicate graphs, see set_collapse_duplicates. Weights are the number of
+  // graphs each graph stands for, empty if not collapsed.
+  bool collapse_duplicates_;
+  std::vector<int> graph_weights_;
+  std::vector<std::vector<int> > duplicate_graphs_;
+  // Hardware counters of each thread, see enable_counters
+  std::unique_ptr<PerfCounters[]> counters_;
+  int ncounters_;
+  // Progress reporting, see set_progress. Counters of each thread while mining.
+  double progress_interval_;
+  std::string progress_file_;
+  std::unique_ptr<progress_counter_t[]> progress_;
+};
+
+/*!
+The mining core for labels and vertex ids of width W, see narrow_width_t. Its
+graphs, DFS codes and kernels use the types of W.
+*/
+template <typename W>
+class GBoltCore : public GBoltBase {
+  // Microbenchmarks drive the mining kernels directly
+  friend class GBoltBench;
+
+ public:
+  using edge_t = basic_edge_t<W>;
+  using vertex_t = basic_vertex_t<W>;
+  using Graph = BasicGraph<W>;
+  using History = BasicHistory<W>;
+  using dfs_code_t = basic_dfs_code_t<W>;
+  using DfsCodes = BasicDfsCodes<W>;
+  using gbolt_instance_t = basic_gbolt_instance_t<W>;
+  using query_node_t = basic_query_node_t<W>;
+
+  // Takes over the options and the labels read so far
+  explicit GBoltCore(GBoltBase &&base) : GBoltBase(std::move(base)) {}
+
+  // Construct the graphs of db from its frequent labels, whose dense ids and
+  // every vertex id must fit W
+  void construct(Database &db,
+    const std::unordered_map<int, int> &vertex_label_ids,
+    const std::unordered_map<int, int> &edge_label_ids);
 
   void execute();
 
-  void save(bool output_parent = false, bool output_pattern = false, bool output_frequent_nodes = false);
+  // Save frequent patterns to output_file.t<thread>, or to output_file if merged
+  void save(bool output_parent, bool output_pattern, bool output_frequent_nodes);
+
+  // Dump the recorded task timeline in Chrome trace-event format
+  void save_trace(const std::string &trace_file) const;
 
  private:
   using ProjectionMap = std::map<dfs_code_t, Projection, dfs_code_project_compare_t>;
   using ProjectionMapBackward = std::map<dfs_code_t, Projection, dfs_code_backward_compare_t>;
   using ProjectionMapForward = std::map<dfs_code_t, Projection, dfs_code_forward_compare_t>;
+  // Embedding-free counterparts, holding supporting graph ids
+  using GraphIdsMap = std::map<dfs_code_t, std::vector<int>, dfs_code_project_compare_t>;
+  using GraphIdsMapBackward = std::map<dfs_code_t, std::vector<int>, dfs_code_backward_compare_t>;
+  using GraphIdsMapForward = std::map<dfs_code_t, std::vector<int>, dfs_code_forward_compare_t>;
+
+  // The graphs supporting a child, counted before its embeddings are materialized
+  struct child_graphs_t {
+    std::vector<int> graph_ids;
+
+    // Called for every embedding of the child, in graph order
+    void emplace_back(int graph_id, uint32_t, uint32_t) {
+      if (graph_ids.empty() || graph_ids.back() != graph_id) {
+        graph_ids.push_back(graph_id);
+      }
+    }
+
+    // Appends the graphs of other, which must not be less
+    void append(const child_graphs_t &other) {
+      auto first = other.graph_ids.begin();
+      if (first != other.graph_ids.end() && !graph_ids.empty() && graph_ids.back() == *first) {
+        ++first;
+      }
+      graph_ids.insert(graph_ids.end(), first, other.graph_ids.end());
+    }
+
+    // Counts do not index into the parent projection
+    void set_parent(const Projection *) {}
+  };
+  using ChildGraphsMapBackward = std::map<dfs_code_t, child_graphs_t, dfs_code_backward_compare_t>;
+  using ChildGraphsMapForward = std::map<dfs_code_t, child_graphs_t, dfs_code_forward_compare_t>;
 
  private:
   // Mine
@@ -120,24 +535,140 @@ class GBolt {
 
   void project();
 
-  void find_frequent_nodes_and_edges(const Database& db);
+  // Construct the projections of all frequent first edges
+  void project(ProjectionMap &projection_map) const;
+
+  // Find the graphs containing each first edge
+  void project(GraphIdsMap &graph_ids_map) const;
+
+  // Mine the appended graphs and merge them with the loaded state
+  void execute_incremental();
 
-  void mine_subgraph(
+  // Mine a sample of the graphs and verify the candidates in all graphs
+  void execute_sample();
+
+  // Keep a single graph of every isomorphism class, see set_collapse_duplicates
+  void collapse_duplicates();
+
+  // Count the supports of the patterns of query_file_
+  void execute_query();
+
+  // Inserts the minimum DFS codes of a query into the trie of query_nodes_
+  void insert_query(const std::vector<wide_dfs_code_t> &dfs_codes, int query);
+
+  // Finds the graphs of every query in the trie, into query_graph_ids_. The
+  // children of patterns with less than nsupport_ are not counted.
+  void count_queries();
+
+  // Records the graphs of projection for the queries of node and materializes
+  // its children, which extend dfs_codes
+  void query_subgraph(
     const Projection &projection,
+    int node,
     DfsCodes &dfs_codes);
 
-  void mine_child(
+  // The embeddings of a pattern in all of its graphs, to be materialized
+  // from those of its parent when needed
+  struct parent_graphs_t {
+    const Projection *projection = nullptr;
+    const std::vector<int> *right_most_path = nullptr;
+    const std::vector<int> *graph_ids = nullptr;
+  };
+
+  /*!
+  Finds the graphs of the state pattern of a trie node among the appended
+  graphs, into query_graph_ids_, from projection, its embeddings there. Its
+  children in the state are walked the same way. Its other children have
+  less than the old border in the old graphs; if they can still reach
+  nsupport_, the pattern is embedded into all of its graphs, from
+  parent_graphs if its parent was, and those children are mined there,
+  collected with their descendants.
+  */
+  void incremental_subgraph(
+    const Projection &projection,
+    int node,
+    DfsCodes &dfs_codes,
+    const parent_graphs_t &parent_graphs);
+
+  // Returns the number of frequent children spawned. Children are reported
+  // with the given parent, the nearest reported ancestor.
+  int mine_subgraph(
+    const Projection &projection,
+    DfsCodes &dfs_codes,
+    int prev_thread_id,
+    int prev_graph_id);
+
+  // Returns true iff a task was spawned for next_code, whose embeddings are
+  // projection
+  bool mine_child(
     const Projection &projection,
     const dfs_code_t& next_code,
     DfsCodes &dfs_codes,
     int prev_thread_id,
     int prev_graph_id);
 
-  #ifdef GBOLT_SERIAL
-  constexpr static int thread_id() { return 0; }
-  #else
-  static int thread_id() { return omp_get_thread_num(); }
-  #endif
+  /*!
+  Returns true iff a task was spawned for next_code, an extension of the
+  pattern of projection supported by graph_ids. The embeddings of next_code
+  are only materialized in its task, once it is known to be minimal, and are
+  freed when its subtree is mined.
+  */
+  bool mine_child(
+    const Projection &projection,
+    const std::vector<int> &right_most_path,
+    const dfs_code_t& next_code,
+    const std::vector<int> &graph_ids,
+    DfsCodes &dfs_codes,
+    int prev_thread_id,
+    int prev_graph_id);
+
+  // Reports or collects the minimal pattern dfs_codes, whose embeddings are
+  // projection, and mines its children. Returns the number of children spawned.
+  int mine_pattern(
+    const Projection &projection,
+    DfsCodes &dfs_codes,
+    int nsupport,
+    int ntarget,
+    int nother,
+    int prev_thread_id,
+    int prev_graph_id);
+
+  // Embedding-free mining, see set_embedding_free
+  int mine_subgraph(
+    const std::vector<int> &graph_ids,
+    DfsCodes &dfs_codes);
+
+  bool mine_child(
+    const std::vector<int> &graph_ids,
+    const dfs_code_t& next_code,
+    DfsCodes &dfs_codes,
+    int prev_thread_id,
+    int prev_graph_id);
+
+  // True iff the children of a pattern with projection should be mined
+  // embedding-free
+  bool switch_embedding_free(const Projection &projection) const;
+
+  // Gaston engine, see set_gaston
+  void gaston_project();
+
+  // Finds the frequent extensions of projection, whose embeddings are those of
+  // child in parent, and returns the number of frequent children spawned
+  int gaston_mine_subgraph(
+    const GastonPattern &pattern,
+    gaston_projection_t &projection,
+    const gaston_projection_t &parent,
+    const gaston_child_t &child);
+
+  // Spawns the task mining pattern, whose embeddings are those of child in
+  // parent, or those of parent for a first edge
+  void gaston_mine_child(
+    const GastonPattern &pattern,
+    const gaston_projection_t &parent,
+    const gaston_child_t &child,
+    int nsupport,
+    int prev_thread_id,
+    int prev_graph_id);
 
   gbolt_instance_t& thread_instance() {
     return gbolt_instances_[thread_id()];
@@ -145,52 +676,153 @@ class GBolt {
 
   // Extend
 
+  /*!
+  Finds all extensions of the embeddings in projection, into maps of either
+  their projections or only their supporting graphs. Large projections are
+  split into chunks of whole runs, and runs larger than a chunk, such as the
+  embeddings of a single large graph, into chunks of their own. Chunks are
+  enumerated by parallel tasks and merged in embedding order.
+  */
+  template <typename MapBackward, typename MapForward>
   void enumerate(
     const DfsCodes &dfs_codes,
     const Projection &projection,
     const std::vector<int> &right_most_path,
-    ProjectionMapBackward &projection_map_backward,
-    ProjectionMapForward &projection_map_forward);
+    MapBackward &projection_map_backward,
+    MapForward &projection_map_forward);
+
+  // Enumerates the embeddings [first, last) of projection
+  template <typename MapBackward, typename MapForward>
+  void enumerate_embeddings(
+    const DfsCodes &dfs_codes,
+    const Projection &projection,
+    const std::vector<int> &right_most_path,
+    uint32_t first,
+    uint32_t last,
+    MapBackward &projection_map_backward,
+    MapForward &projection_map_forward);
 
+  /*!
+  Finds the embeddings of the last code of dfs_codes, a minimal code
+  extending projection, in the given graphs of projection into child.
+  right_most_path is the rightmost path of projection's pattern.
+  */
+  void materialize(
+    const DfsCodes &dfs_codes,
+    const Projection &projection,
+    const std::vector<int> &right_most_path,
+    const std::vector<int> &graph_ids,
+    Projection &child);
+
+  /*!
+  Finds all embeddings of dfs_codes in graph. levels must hold one projection
+  per code, and levels[i] is filled with the embeddings of the first i + 1
+  codes. Returns false iff graph does not contain the pattern.
+  */
+  bool embed(
+    const DfsCodes &dfs_codes,
+    const Graph &graph,
+    std::vector<Projection> &levels);
+
+  // Finds all embeddings of dfs_codes in the given graphs, into levels as above
+  void embed(
+    const DfsCodes &dfs_codes,
+    const std::vector<int> &graph_ids,
+    std::vector<Projection> &levels);
+
+  template <typename Map>
   void get_first_forward(
-    const prev_dfs_t &prev_dfs,
+    uint32_t prev,
     const History &history,
     const Graph &graph,
     const DfsCodes &dfs_codes,
     const std::vector<int> &right_most_path,
-    ProjectionMapForward &projection_map_forward);
+    Map &projection_map_forward);
 
+  template <typename Map>
   void get_other_forward(
-    const prev_dfs_t &prev_dfs,
+    uint32_t prev,
     const History &history,
     const Graph &graph,
     const DfsCodes &dfs_codes,
     const std::vector<int> &right_most_path,
-    ProjectionMapForward &projection_map_forward);
+    Map &projection_map_forward);
 
+  template <typename Map>
   void get_backward(
-    const prev_dfs_t &prev_dfs,
+    uint32_t prev,
     const History &history,
     const Graph &graph,
     const DfsCodes &dfs_codes,
     const std::vector<int> &right_most_path,
-    ProjectionMapBackward &projection_map_backward);
+    Map &projection_map_backward);
+
+  // Count, weighted by the duplicates of each graph
+  using GBoltBase::count_support;
 
-  // Count
-  static int count_support(const Projection &projection);
+  int count_support(const Projection &projection) const;
+
+  // Number of graphs of the target class and of the others supporting projection
+  using GBoltBase::count_classes;
+
+  void count_classes(const Projection &projection, int &ntarget, int &nother) const;
+
+  /*!
+  Returns the minimum image based support of dfs_codes extended by next_code,
+  whose embeddings are projection, or a number less than nsupport_ if it is
+  infrequent. Large projections are split into chunks counted by parallel
+  tasks.
+  */
+  int count_mni(const Projection &projection, const DfsCodes &dfs_codes,
+    const dfs_code_t &next_code) const;
 
  private:
   // Graphs after reconstructing
   std::vector<Graph> graphs_;
-  // Single instance of minigraph
-  std::unordered_map<int, std::vector<int> > frequent_vertex_labels_;
-  std::unordered_map<int, int> frequent_edge_labels_;
-  std::string output_file_;
-  double support_;
-  int nsupport_;
+  GastonKeys gaston_keys_;
+  // Trie of the pattern queries, see set_query. The first node is the root.
+  std::vector<query_node_t> query_nodes_;
   std::vector<gbolt_instance_t> gbolt_instances_;
 };
 
+// Explicitly instantiates the members of GBoltCore and of its instances that a
+// source file defines, given as a macro of the width, for every width
+#define GBOLT_INSTANTIATE_WIDTHS(MEMBERS) \
+  MEMBERS(narrow_width_t) \
+  MEMBERS(wide_width_t)
+
+/*!
+Frequent subgraph miner. Options are set before read_input, which picks the
+narrowest width the input fits and moves them into the mining core of that
+width. The other methods run on that core.
+*/
+class GBolt : public GBoltBase {
+  // Microbenchmarks drive the mining kernels directly
+  friend class GBoltBench;
+
+ public:
+  GBolt(const std::string &output_file, double support) :
+    GBoltBase(output_file, support) {}
+
+  void read_input(const std::string &input_file, const std::string &separator);
+
+  void execute();
+
+  // Save frequent patterns to output_file.t<thread>, or to output_file if merged
+  void save(bool output_parent = false, bool output_pattern = false, bool output_frequent_nodes = false);
+
+  // Dump the recorded task timeline in Chrome trace-event format
+  void save_trace(const std::string &trace_file) const;
+
+  // Log the counts, IPC and miss rates of every phase, summed over all threads
+  void report_counters() const;
+
+ private:
+  // The core of the width chosen by read_input, the other one is null
+  std::unique_ptr<GBoltCore<narrow_width_t> > narrow_;
+  std::unique_ptr<GBoltCore<wide_width_t> > wide_;
+};
+
 }  // namespace gbolt
 
 #endif  // INCLUDE_GBOLT_H_
@@ -0,0 +1,88 @@
+#ifndef INCLUDE_GENERATOR_H_
+#define INCLUDE_GENERATOR_H_
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <random>
+#include <unordered_set>
+#include <cstdint>
+
+namespace gbolt {
+
+struct generator_config_t {
+  //! Number of graphs to generate.
+  int64_t ngraphs = 1000;
+
+  //! Average number of edges per graph.
+  double avg_edges = 20.0;
+
+  //! Number of distinct vertex and edge labels.
+  int nvertex_labels = 20;
+  int nedge_labels = 5;
+
+  //! Average number of edges per vertex, 1.0 gives trees.
+  double density = 1.2;
+
+  //! Number of planted frequent seed patterns, and their average number of edges.
+  int nseeds = 50;
+  double avg_seed_edges = 5.0;
+
+  //! Fraction of each graph's edges covered by planted seeds.
+  double seed_fraction = 0.5;
+
+  //! Random seed, the same configuration always produces the same database.
+  uint64_t random_seed = 1;
+};
+
+/*!
+A Generator writes a synthetic graph database in the gBolt input format,
+in the spirit of the classic gSpan/FSG generator: every graph is made of
+copies of a fixed set of weighted seed patterns, connected to each other and
+padded with random vertices and edges. Graphs are generated and written one at
+a time, so memory only depends on the size of the largest graph.
+*/
+class Generator {
+ public:
+  explicit Generator(const generator_config_t &config);
+
+  // Write all graphs to out
+  void write(std::ostream &out);
+
+  int64_t nvertices() const { return nvertices_; }
+
+  int64_t nedges() const { return nedges_; }
+
+ private:
+  struct gen_edge_t {
+    gen_edge_t(int from, int to, int label) : from(from), to(to), label(label) {}
+    int from, to, label;
+  };
+  struct gen_graph_t {
+    std::vector<int> labels;
+    std::vector<gen_edge_t> edges;
+  };
+
+  // Add random vertices and edges to graph until it has nvertices vertices
+  // and nedges edges, keeping it connected
+  void grow(std::mt19937_64 &rng, int nvertices, int nedges, gen_graph_t &graph);
+
+  bool add_edge(int from, int to, int label, gen_graph_t &graph);
+
+  void generate_graph(int64_t id, gen_graph_t &graph);
+
+  void write_graph(int64_t id, const gen_graph_t &graph, std::string &buffer);
+
+ private:
+  generator_config_t config_;
+  std::vector<gen_graph_t> seeds_;
+  std::discrete_distribution<int> seed_dist_;
+  // Vertex pairs already connected in the graph being generated
+  std::unordered_set<uint64_t> adjacency_;
+  int64_t nvertices_;
+  int64_t nedges_;
+};
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_GENERATOR_H_
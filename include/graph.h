@@ -2,79 +2,199 @@
 #define INCLUDE_GRAPH_H_
 
 #include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
 
 namespace gbolt {
 
+/*!
+Widths of dense labels and of vertex ids within a graph or a pattern. The
+mining core is instantiated for each width, and read_input picks the narrow
+one if the input fits it. Chemical datasets fit 8 bit labels and 16 bit vertex
+ids, which pack a DFS code into 8 bytes.
+*/
+struct wide_width_t {
+  using label_t = int;
+  using vid_t = int;
+};
+
+struct narrow_width_t {
+  using label_t = uint8_t;
+  using vid_t = uint16_t;
+};
+
 // Direct edge structure
-struct edge_t {
-  edge_t(int from, int label, int to, int id) :
-    from(from), label(label), to(to), id(id) {}
+template <typename W>
+struct basic_edge_t {
+  basic_edge_t(int from, int label, int to, int id) :
+    from(from), to(to), label(label), id(id) {}
 
-  int from;
-  int label;
-  int to;
+  typename W::vid_t from;
+  typename W::vid_t to;
+  typename W::label_t label;
   int id;
 };
 
 // dfs projection links
-struct min_prev_dfs_t {
-  min_prev_dfs_t(const edge_t& edge, int prev) :
+template <typename W>
+struct basic_min_prev_dfs_t {
+  basic_min_prev_dfs_t(const basic_edge_t<W>& edge, int prev) :
     edge(edge), prev(prev) {}
 
-  const edge_t& edge;
+  const basic_edge_t<W>& edge;
   int prev;
 };
-using MinProjection = std::vector<min_prev_dfs_t>;
+template <typename W>
+using BasicMinProjection = std::vector<basic_min_prev_dfs_t<W> >;
 
 /*!
 A prev_dfs_t represents an instance of a subgraph being found within
-an input graph.
+an input graph. It is stored relative to the Projection holding it: the graph
+is given by the projection run containing it, and the previous instance lives
+in the parent projection, so both links fit in 32 bits.
 */
 struct prev_dfs_t {
-  prev_dfs_t(int id, const edge_t& edge, const prev_dfs_t *prev) :
-    id(id), edge(edge), prev(prev) {}
+  prev_dfs_t(uint32_t edge, uint32_t prev) :
+    edge(edge), prev(prev) {}
 
-  //! The ID of the graph the subgraph was found in.
-  int id;
+  //! The index in Graph::edges of the last edge in the DFS code representation of the subgraph.
+  uint32_t edge;
 
-  //! A reference to the last edge in the DFS code representation of the subgraph.
-  const edge_t& edge;
+  //! The index in the parent projection of the subgraph instance without the last edge.
+  uint32_t prev;
+};
+
+//! Header of the run of consecutive prev_dfs_ts found in the same graph.
+struct projection_run_t {
+  projection_run_t(int id, uint32_t begin) :
+    id(id), begin(begin) {}
+
+  //! The ID of the graph the subgraphs were found in.
+  int id;
 
-  //! A pointer to the subgraph instance without the last edge.
-  const prev_dfs_t *prev;
+  //! The index of the first prev_dfs_t of the run.
+  uint32_t begin;
 };
 
 /*!
-A Projection represents a support list. Subgraphs are grouped by graph ID, such that
-if two prev_dfs_ts have the same ID, they are either adjacent or separated by other
-prev_dfs_ts with the same ID.
+A Projection represents a support list. Subgraphs are grouped by graph ID into
+runs, such that all prev_dfs_ts of a graph are adjacent. The projection of a
+DFS code sequence points to the projection of the sequence without its last
+code, which prev_dfs_t::prev indexes into. First edge projections have no parent.
 */
-using Projection = std::vector<prev_dfs_t>;
+class Projection {
+ public:
+  //! prev of first edge instances.
+  static const uint32_t npos = UINT32_MAX;
+
+  Projection() : parent_(nullptr) {}
+
+  void emplace_back(int graph_id, uint32_t edge, uint32_t prev) {
+    if (runs_.empty()) {
+      // Skips the first few reallocations, which most projections go through
+      runs_.reserve(8);
+      embeddings_.reserve(16);
+    }
+    if (runs_.empty() || runs_.back().id != graph_id) {
+      runs_.emplace_back(graph_id, embeddings_.size());
+    }
+    embeddings_.emplace_back(edge, prev);
+  }
+
+  const prev_dfs_t& operator[](size_t index) const {
+    return embeddings_[index];
+  }
+
+  size_t size() const {
+    return embeddings_.size();
+  }
+
+  const std::vector<projection_run_t>& runs() const {
+    return runs_;
+  }
+
+  //! One past the index of the last prev_dfs_t of the given run.
+  uint32_t run_end(size_t run) const {
+    return run + 1 < runs_.size() ? runs_[run + 1].begin : embeddings_.size();
+  }
+
+  const Projection* parent() const {
+    return parent_;
+  }
+
+  void set_parent(const Projection *parent) {
+    parent_ = parent;
+  }
+
+  //! Appends the instances of other, whose graph IDs must not be less. The
+  //! first run of other continues the last run if they share their graph.
+  void append(const Projection &other) {
+    const uint32_t offset = embeddings_.size();
+    for (const auto& run : other.runs_) {
+      if (runs_.empty() || runs_.back().id != run.id) {
+        runs_.emplace_back(run.id, run.begin + offset);
+      }
+    }
+    embeddings_.insert(embeddings_.end(), other.embeddings_.begin(), other.embeddings_.end());
+  }
+
+  //! Removes all instances, keeping the parent and the capacity.
+  void clear() {
+    runs_.clear();
+    embeddings_.clear();
+  }
+
+ private:
+  std::vector<projection_run_t> runs_;
+  std::vector<prev_dfs_t> embeddings_;
+  const Projection *parent_;
+};
 
 // dfs codes forward and backward compare
-struct dfs_code_t {
-  bool operator != (const dfs_code_t &t) const {
+template <typename W>
+struct basic_dfs_code_t {
+  basic_dfs_code_t() : from(0), to(0), from_label(0), edge_label(0), to_label(0) {}
+
+  // Narrows ids and labels to the width
+  basic_dfs_code_t(int from, int to, int from_label, int edge_label, int to_label) :
+    from(from), to(to), from_label(from_label), edge_label(edge_label),
+    to_label(to_label) {}
+
+  // Converts a code of another width, whose ids and labels must fit
+  template <typename V>
+  explicit basic_dfs_code_t(const basic_dfs_code_t<V> &code) :
+    from(code.from), to(code.to), from_label(code.from_label),
+    edge_label(code.edge_label), to_label(code.to_label) {}
+
+  bool operator != (const basic_dfs_code_t &t) const {
     return (from != t.from) || (to != t.to) ||
       (from_label != t.from_label) || (edge_label != t.edge_label) ||
       (to_label != t.to_label);
   }
 
-  bool operator == (const dfs_code_t &t) const {
+  bool operator == (const basic_dfs_code_t &t) const {
     return (from == t.from) && (to == t.to) &&
       (from_label == t.from_label) && (edge_label == t.edge_label) &&
       (to_label == t.to_label);
   }
 
-  int from;
-  int to;
-  int from_label;
-  int edge_label;
-  int to_label;
+  typename W::vid_t from;
+  typename W::vid_t to;
+  typename W::label_t from_label;
+  typename W::label_t edge_label;
+  typename W::label_t to_label;
 };
-using DfsCodes = std::vector<const dfs_code_t *>;
+template <typename W>
+using BasicDfsCodes = std::vector<const basic_dfs_code_t<W> *>;
+
+// Codes of patterns kept across widths, as in saved states and query files
+using wide_dfs_code_t = basic_dfs_code_t<wide_width_t>;
 
 struct dfs_code_project_compare_t {
-  bool operator() (const dfs_code_t &first, const dfs_code_t &second) const {
+  template <typename W>
+  bool operator() (const basic_dfs_code_t<W> &first, const basic_dfs_code_t<W> &second) const {
     if (first.from_label != second.from_label) {
       return first.from_label < second.from_label;
     } else {
@@ -88,7 +208,8 @@ struct dfs_code_project_compare_t {
 };
 
 struct dfs_code_backward_compare_t {
-  bool operator() (const dfs_code_t &first, const dfs_code_t &second) const {
+  template <typename W>
+  bool operator() (const basic_dfs_code_t<W> &first, const basic_dfs_code_t<W> &second) const {
     if (first.to != second.to) {
       return first.to < second.to;
     } else {
@@ -98,7 +219,8 @@ struct dfs_code_backward_compare_t {
 };
 
 struct dfs_code_forward_compare_t {
-  bool operator() (const dfs_code_t &first, const dfs_code_t &second) const {
+  template <typename W>
+  bool operator() (const basic_dfs_code_t<W> &first, const basic_dfs_code_t<W> &second) const {
     if (first.from != second.from) {
       return first.from > second.from;
     } else {
@@ -111,23 +233,95 @@ struct dfs_code_forward_compare_t {
   }
 };
 
-struct vertex_t {
-  vertex_t() : id(0), label(0) {}
-  vertex_t(int id, int label) : id(id), label(label) {}
+//! A range of a Graph's edge array.
+template <typename W>
+class BasicEdgeRange {
+ public:
+  using edge_t = basic_edge_t<W>;
 
-  int id;
-  int label;
-  std::vector<edge_t> edges;
+  BasicEdgeRange() : first_(nullptr), last_(nullptr) {}
+  BasicEdgeRange(const edge_t *first, const edge_t *last) : first_(first), last_(last) {}
+
+  const edge_t* begin() const { return first_; }
+
+  const edge_t* end() const { return last_; }
+
+  size_t size() const { return last_ - first_; }
+
+  bool empty() const { return first_ == last_; }
+
+ private:
+  const edge_t *first_;
+  const edge_t *last_;
+};
+
+template <typename W>
+struct basic_vertex_t {
+  basic_vertex_t() : id(0), label(0) {}
+  basic_vertex_t(int id, int label) : id(id), label(label) {}
+
+  typename W::vid_t id;
+  typename W::label_t label;
+  //! The edges leaving this vertex.
+  BasicEdgeRange<W> edges;
 };
-using Vertice = std::vector<vertex_t>;
 
-class Graph {
+template <typename W>
+class BasicGraph {
  public:
-  Graph() : id(0), nedges(0) {}
+  using edge_t = basic_edge_t<W>;
+  using vertex_t = basic_vertex_t<W>;
+
+  BasicGraph() : id(0), nedges(0) {}
+
+  // Vertices point into edges, so a copy would point into the original
+  BasicGraph(const BasicGraph &) = delete;
+  BasicGraph& operator=(const BasicGraph &) = delete;
+  BasicGraph(BasicGraph &&) = default;
+  BasicGraph& operator=(BasicGraph &&) = default;
+
+  /*!
+  Stores each of the given undirected edges once from both ends, grouped by
+  vertex, and points the vertices at their edges. Vertice must already hold
+  every vertex. Edge ids must be unique and less than the number of edges.
+  The edges of every vertex are sorted by (edge label, to vertex label).
+  */
+  void build_edges(const std::vector<edge_t> &undirected_edges);
+
+  /*!
+  Returns the first edge in [first, last), a sorted range of a vertex's edges,
+  whose (edge label, to vertex label) is not less than (label, to_label).
+  Most vertices have a few edges, which are scanned instead of bisected.
+  */
+  const edge_t* lower_bound(const edge_t *first, const edge_t *last,
+    int label, int to_label) const {
+    const auto less = [this](const edge_t &edge, const std::pair<int, int> &key) {
+      return edge.label < key.first ||
+        (edge.label == key.first && vertice[edge.to].label < key.second);
+    };
+    const std::pair<int, int> key(label, to_label);
+    if (last - first <= linear_scan_edges) {
+      while (first != last && less(*first, key)) {
+        ++first;
+      }
+      return first;
+    }
+    return std::lower_bound(first, last, key, less);
+  }
+
+  //! Edge ranges up to this long are scanned by lower_bound.
+  static const ptrdiff_t linear_scan_edges = 8;
+
+  //! The index of edge, which must belong to this graph, in edges.
+  uint32_t edge_index(const edge_t &edge) const {
+    return &edge - edges.data();
+  }
 
   int id;
   int nedges;
-  Vertice vertice;
+  std::vector<vertex_t> vertice;
+  //! Every edge of the graph, twice, ordered by the vertex it leaves.
+  std::vector<edge_t> edges;
 };
 
 }  // namespace gbolt
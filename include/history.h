@@ -2,26 +2,33 @@
 #define INCLUDE_HISTORY_H_
 
 #include <graph.h>
+#include <cstdint>
 
 namespace gbolt {
 
-class History {
+template <typename W>
+class BasicHistory {
  public:
-  History(int max_edges, int max_vertice) : edge_size_(0) {
+  using edge_t = basic_edge_t<W>;
+  using Graph = BasicGraph<W>;
+  using MinProjection = BasicMinProjection<W>;
+
+  BasicHistory(int max_edges, int max_vertice) : edge_size_(0) {
     edges_ = new ConstEdgePointer[max_edges];
-    has_edges_ = new bool[max_edges];
-    has_vertice_ = new int[max_vertice];
+    levels_ = new const prev_dfs_t*[max_edges];
+    has_edges_ = new bool[max_edges]();
+    has_vertice_ = new int[max_vertice]();
   }
 
   /*!
   Clears the contents of this History, and refills the arrays
-  using start.
+  using the index-th instance of projection.
   */
-  void build(const prev_dfs_t &start, const Graph &graph);
+  void build(const Projection &projection, uint32_t index, const Graph &graph);
 
-  void build_edges_min(const MinProjection &projection, const Graph &graph, int start);
+  void build_edges_min(const MinProjection &projection, int start);
 
-  void build_vertice_min(const MinProjection &projection, const Graph &graph, int start);
+  void build_vertice_min(const MinProjection &projection, int start);
 
   bool has_edges(int index) const {
     return has_edges_[index];
@@ -35,10 +42,18 @@ class History {
     return *(edges_[edge_size_ - index - 1]);
   }
 
-  void clear() { current = nullptr; }
+  /*!
+  Forgets the last build. Its graph must still be alive, since only the
+  entries of its edges are cleared.
+  */
+  void clear() {
+    reset();
+    current = nullptr;
+  }
 
-  ~History() {
+  ~BasicHistory() {
     delete[] edges_;
+    delete[] levels_;
     delete[] has_edges_;
     delete[] has_vertice_;
   }
@@ -46,18 +61,50 @@ class History {
  private:
   using ConstEdgePointer = const edge_t *;
 
+  // Forgets every edge and vertex by clearing only the entries of the edges
+  // held, whatever the size of the graph
+  void reset() {
+    for (int i = 0; i < edge_size_; ++i) {
+      has_edges_[edges_[i]->id] = false;
+      has_vertice_[edges_[i]->from] = 0;
+      has_vertice_[edges_[i]->to] = 0;
+    }
+    edge_size_ = 0;
+  }
+
+  void toggle_edge(int index) {
+    has_edges_[index] = !has_edges_[index];
+  }
+
+  void add_vertex(int index) {
+    ++has_vertice_[index];
+  }
+
+  void remove_vertex(int index) {
+    --has_vertice_[index];
+  }
+
+ private:
   // edges_ and edge_size_ effectively make up a vector. The claim
   // here seems to be that doing it this way saves memory in comparison
   // to push_back, though I have no idea how this is the case.
   ConstEdgePointer *edges_;
 
+  // The instances of current and of each of its ancestors, from the last
+  // level down, so that builds of the same projection skip the parent chain.
+  const prev_dfs_t **levels_;
+  int level_size_ = 0;
+
   // has_edges_ and has_vertice_ at a given index is true if this history has been
-  // built with an object that has that given edge/vertex ID.
+  // built with an object that has that given edge/vertex ID. Vertices count the
+  // edges of the history touching them, so that an edge can be swapped out
+  // without rebuilding.
   bool *has_edges_;
   int *has_vertice_;
   int edge_size_;
 
-  const prev_dfs_t* current = nullptr;
+  const Projection* current = nullptr;
+  uint32_t current_index = 0;
   const Graph* cur_graph = nullptr;
 };
 
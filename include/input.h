@@ -0,0 +1,75 @@
+#ifndef INCLUDE_INPUT_H_
+#define INCLUDE_INPUT_H_
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace gbolt {
+
+/*!
+An InputReader reads the lines of a graph file, or of stdin for "-". Gzip and
+zstd compressed input is recognized by its magic bytes and decompressed on the
+fly. A reader thread reads and decompresses blocks into a bounded queue, so
+that decompression overlaps parsing.
+*/
+class InputReader {
+ public:
+  explicit InputReader(const std::string &input_file);
+
+  ~InputReader();
+
+  InputReader(const InputReader &) = delete;
+  InputReader& operator=(const InputReader &) = delete;
+
+  //! Reads the next line into line, without its newline. Returns false at the end of input.
+  bool getline(std::string &line);
+
+ private:
+  // Run on the reader thread
+  void read();
+
+  void read_plain();
+
+  void read_gzip();
+
+  void read_zstd();
+
+  // Reads the next raw block, starting with the magic bytes
+  size_t read_raw(char *buffer, size_t size);
+
+  // Queues a decoded block, waiting while the queue is full. Returns false if
+  // the reader is being destroyed.
+  bool push(std::string &&block);
+
+  // Ends the input, with an error message unless it is empty
+  void finish(const std::string &error);
+
+  // Takes the next block from the queue into block_. Returns false at the end of input.
+  bool next_block();
+
+ private:
+  FILE *file_;
+  std::string magic_;
+  size_t magic_pos_;
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<std::string> blocks_;
+  bool done_;
+  bool stop_;
+  std::string error_;
+
+  // The block being parsed
+  std::string block_;
+  size_t pos_;
+};
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_INPUT_H_
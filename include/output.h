@@ -8,7 +8,7 @@ namespace gbolt {
 
 class Output {
  public:
-  explicit Output(const std::string &output_file): output_file_(output_file) {}
+  explicit Output(const std::string &output_file): output_file_(output_file), keep_keys_(false) {}
 
   int size() const {
     return support_.size();
@@ -18,14 +18,41 @@ class Output {
 
   void push_back(const std::string &str, int nsupport, int thread_id, int parent_id);
 
+  // Results pushed with a key keep it for save_merged
+  void push_back(const std::string &str, int nsupport, int thread_id, int parent_id,
+    const std::string &key);
+
+  // Keep the keys of the results pushed from now on
+  void keep_keys() { keep_keys_ = true; }
+
+  bool keeps_keys() const { return keep_keys_; }
+
   void save(bool output_parent = false, bool output_pattern = false);
 
+  // Save only the results with at least nsupport to output_file, keeping
+  // their ids. Parents of frequent results are frequent, so they are kept too.
+  void save(const std::string &output_file, bool output_parent, bool output_pattern,
+    int nsupport) const;
+
+  // Save the results of all outputs, indexed by thread id, to a single
+  // output_file. Results get global ids in the order of their keys, and parent
+  // ids are rewritten to them. Ranges of keys between sampled splitters are
+  // merged in parallel, then chunks of results are formatted in parallel and
+  // written at their offsets. With a parent_key_size, the parent of a result
+  // is the result keyed by its key without the last parent_key_size bytes,
+  // instead of the pushed one.
+  static void save_merged(const std::vector<const Output *> &outputs,
+    const std::string &output_file, bool output_parent, bool output_pattern, int nsupport,
+    size_t parent_key_size = 0);
+
  private:
   std::vector<std::string> buffer_;
   std::vector<int> support_;
   std::vector<int> thread_id_;
   std::vector<int> parent_id_;
+  std::vector<std::string> keys_;
   const std::string output_file_;
+  bool keep_keys_;
 };
 
 }  // namespace gbolt
@@ -0,0 +1,88 @@
+#ifndef INCLUDE_PROGRESS_H_
+#define INCLUDE_PROGRESS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace gbolt {
+
+/*!
+Progress counters of a single mining thread. Only their thread writes them,
+and a Monitor reads them, so increments are relaxed loads and stores instead
+of read-modify-writes. Counters are padded to two cache lines, so that the
+counters of two threads never share a line however the array is aligned.
+*/
+struct progress_counter_t {
+  //! Patterns reported or collected.
+  std::atomic<uint64_t> patterns{0};
+
+  //! Mining tasks spawned and finished on this thread.
+  std::atomic<uint64_t> tasks_spawned{0};
+  std::atomic<uint64_t> tasks_finished{0};
+
+  //! Tasks of single edge patterns, whose whole subtree is mined when they finish.
+  std::atomic<uint64_t> subtrees_spawned{0};
+  std::atomic<uint64_t> subtrees_finished{0};
+
+  char padding[128 - 5 * sizeof(std::atomic<uint64_t>)];
+};
+
+inline void progress_add(std::atomic<uint64_t> &counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*!
+A Monitor thread sums the progress counters of all mining threads every
+interval seconds, and logs the number of patterns, the patterns per second,
+the finished and spawned first level subtrees, the outstanding tasks and the
+resident memory. With a status file, the status is written there instead,
+replacing the file atomically, and the last status is marked done.
+*/
+class Monitor {
+ public:
+  Monitor(const progress_counter_t *counters, int ncounters, double interval,
+    const std::string &status_file);
+
+  ~Monitor();
+
+  Monitor(const Monitor &) = delete;
+  Monitor& operator=(const Monitor &) = delete;
+
+  void start();
+
+  //! Stops the thread and reports the final status.
+  void stop();
+
+ private:
+  // Run on the monitor thread
+  void run();
+
+  void report(bool done);
+
+  // Resident set size of the process in bytes, 0 if unknown
+  static uint64_t resident_memory();
+
+ private:
+  const progress_counter_t *counters_;
+  int ncounters_;
+  std::chrono::duration<double> interval_;
+  std::string status_file_;
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_;
+
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_time_;
+  uint64_t last_patterns_;
+};
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_PROGRESS_H_
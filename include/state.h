@@ -0,0 +1,61 @@
+#ifndef INCLUDE_STATE_H_
+#define INCLUDE_STATE_H_
+
+#include <graph.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+namespace gbolt {
+
+// Lexicographic order of DFS code sequences, parents before their children
+struct dfs_codes_less_t {
+  template <typename W>
+  bool operator() (const std::vector<basic_dfs_code_t<W> > &first,
+    const std::vector<basic_dfs_code_t<W> > &second) const {
+    return std::lexicographical_compare(first.begin(), first.end(),
+      second.begin(), second.end(),
+      [](const basic_dfs_code_t<W> &a, const basic_dfs_code_t<W> &b) {
+        if (a.from != b.from) return a.from < b.from;
+        if (a.to != b.to) return a.to < b.to;
+        if (a.from_label != b.from_label) return a.from_label < b.from_label;
+        if (a.edge_label != b.edge_label) return a.edge_label < b.edge_label;
+        return a.to_label < b.to_label;
+      });
+  }
+};
+
+// A frequent pattern and the ids of its supporting graphs, with wide codes
+// whatever the width it was mined with
+struct pattern_t {
+  std::vector<wide_dfs_code_t> dfs_codes;
+  std::vector<int> graph_ids;
+};
+
+/*!
+A state_t persists a mining run for incremental mining: the number of graphs
+mined, the border support, the order of the dense labels, and every pattern
+whose support reached the border, with its supporting graphs. Patterns are
+stored as DFS codes of dense labels.
+*/
+struct state_t {
+  void read(const std::string &state_file);
+
+  void write(const std::string &state_file) const;
+
+  int ngraphs = 0;
+
+  //! Relative border support, and the support it gave for ngraphs.
+  double border = 0.0;
+  int nborder = 0;
+
+  //! Original labels of the dense vertex and edge labels.
+  std::vector<int> vertex_labels;
+  std::vector<int> edge_labels;
+
+  std::vector<pattern_t> patterns;
+};
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_STATE_H_
@@ -0,0 +1,72 @@
+#ifndef INCLUDE_TRACE_H_
+#define INCLUDE_TRACE_H_
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <chrono>
+#include <cstdint>
+
+namespace gbolt {
+
+/*!
+A trace_event_t records a single mining task, i.e. one run of the task body
+in GBolt::mine_child, including the time spent in its nested children.
+*/
+struct trace_event_t {
+  trace_event_t(int64_t start, int64_t end, int depth,
+    int projection_size, int nsupport, int nchildren, bool is_min) :
+    start(start), end(end), depth(depth), projection_size(projection_size),
+    nsupport(nsupport), nchildren(nchildren), is_min(is_min) {}
+
+  //! Start and end timestamps in microseconds.
+  int64_t start;
+  int64_t end;
+
+  //! Number of edges of the pattern mined by the task.
+  int depth;
+
+  //! Number of embeddings and supporting graphs of the pattern.
+  int projection_size;
+  int nsupport;
+
+  //! Number of frequent children spawned by the task.
+  int nchildren;
+
+  //! False if the task was pruned by the minimality check.
+  bool is_min;
+};
+
+/*!
+A Trace is a per-thread buffer of trace events. Each thread only appends to
+its own buffer, so recording never takes a lock. Buffers are merged into a
+Chrome/Perfetto trace-event file once mining has finished.
+*/
+class Trace {
+ public:
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void push_back(const trace_event_t &event) {
+    events_.push_back(event);
+  }
+
+  bool empty() const {
+    return events_.empty();
+  }
+
+  int64_t start() const;
+
+  // Write all events of thread tid as a comma separated list of JSON objects,
+  // with timestamps relative to epoch
+  void save(std::ostream &out, int tid, int64_t epoch, bool &first) const;
+
+ private:
+  std::vector<trace_event_t> events_;
+};
+
+}  // namespace gbolt
+
+#endif  // INCLUDE_TRACE_H_
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Compressed and stdin input must give the same patterns as the plain file,
+# also when the decoded input ends exactly on a full 1 MiB block
+
+GBOLT=${GBOLT:-./build/gbolt}
+TMP=$(mktemp -d /tmp/gbolt_input.XXXXXX)
+trap 'rm -rf $TMP' EXIT
+export OMP_NUM_THREADS=1
+
+# Blank lines are skipped, they pad the input to the block size
+cp extern/data/Chemical_340 $TMP/data
+head -c $((1048576 - $(wc -c < $TMP/data))) /dev/zero | tr '\0' '\n' >> $TMP/data
+if [[ $(wc -c < $TMP/data) -ne 1048576 ]]; then
+  echo "padded input is not 1048576 bytes"
+  exit 1
+fi
+
+count() {
+  cat $TMP/out.t* | grep -c '^t #'
+  rm -f $TMP/out.t*
+}
+
+$GBOLT -s 0.1 -i $TMP/data -o $TMP/out > /dev/null || exit 1
+EXPECTED=$(count)
+
+check() {
+  local name=$1
+  shift
+  if ! "$@" > /dev/null; then
+    echo "$name input failed"
+    exit 1
+  fi
+  RES=$(count)
+  if [[ $RES -ne $EXPECTED ]]; then
+    echo "$name input: $RES subgraphs, expected $EXPECTED"
+    exit 1
+  fi
+}
+
+check stdin sh -c "$GBOLT -s 0.1 -i - -o $TMP/out < $TMP/data"
+gzip -c $TMP/data > $TMP/data.gz
+check gzip $GBOLT -s 0.1 -i $TMP/data.gz -o $TMP/out
+# Concatenated gzip members, each ending on a full block
+cat $TMP/data.gz $TMP/data.gz > $TMP/data2.gz
+EXPECTED=$(cat $TMP/data $TMP/data > $TMP/data2 && $GBOLT -s 0.1 -i $TMP/data2 -o $TMP/out > /dev/null && count)
+check "gzip members" $GBOLT -s 0.1 -i $TMP/data2.gz -o $TMP/out
+if command -v zstd > /dev/null; then
+  zstd -q -c $TMP/data > $TMP/data.zst
+  EXPECTED=$($GBOLT -s 0.1 -i $TMP/data -o $TMP/out > /dev/null && count)
+  check zstd $GBOLT -s 0.1 -i $TMP/data.zst -o $TMP/out
+fi
+echo "input check passed"
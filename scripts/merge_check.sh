@@ -0,0 +1,27 @@
+#!/bin/bash
+# Merged output must not depend on the number of threads, for both engines,
+# and gaston must save the same file as gSpan
+
+GBOLT=${GBOLT:-./build/gbolt}
+THREADS=${THREADS:-4}
+SUPPORT=${SUPPORT:-0.1}
+TMP=$(mktemp -d /tmp/gbolt_merge.XXXXXX)
+trap 'rm -rf $TMP' EXIT
+
+for engine in gspan gaston; do
+  for threads in 1 $THREADS; do
+    OMP_NUM_THREADS=$threads $GBOLT -i extern/data/Compound_422 -s $SUPPORT \
+      -o $TMP/$engine.$threads -p -d --merge-output --engine $engine > /dev/null || exit 1
+  done
+  if ! cmp -s $TMP/$engine.1 $TMP/$engine.$THREADS; then
+    echo "$engine: merged output differs between 1 and $THREADS threads"
+    diff $TMP/$engine.1 $TMP/$engine.$THREADS | head
+    exit 1
+  fi
+done
+if ! cmp -s $TMP/gspan.1 $TMP/gaston.1; then
+  echo "gaston: merged output differs from gspan"
+  diff $TMP/gspan.1 $TMP/gaston.1 | head
+  exit 1
+fi
+echo "merge check passed"
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Performance regression check for gBolt.
+
+Runs gbolt over the matrix of datasets, supports and thread counts listed in
+the baseline file and records wall time, peak RSS (getrusage of the child),
+pattern count and throughput of every run as JSON. Exits non-zero if a run
+is slower or uses more memory than the baseline allows, or if it finds a
+different number of patterns.
+
+    ./scripts/perf_check.py --gbolt build/gbolt
+    ./scripts/perf_check.py --gbolt build/gbolt --update   # rewrite baseline
+"""
+
+import argparse
+import glob
+import json
+import os
+import sys
+import tempfile
+import time
+
+
+def run_gbolt(gbolt, data, support, threads):
+    """Run gbolt once, returns (wall seconds, peak RSS kb, pattern count)."""
+    with tempfile.TemporaryDirectory(prefix='gbolt_perf_') as tmp:
+        output = os.path.join(tmp, 'output')
+        env = dict(os.environ, OMP_NUM_THREADS=str(threads))
+        args = [gbolt, '-i', data, '-s', str(support), '-o', output]
+        with open(os.devnull, 'w') as devnull:
+            start = time.monotonic()
+            pid = os.fork()
+            if pid == 0:
+                try:
+                    os.dup2(devnull.fileno(), 1)
+                    os.execve(gbolt, args, env)
+                finally:
+                    os._exit(127)
+            _, status, rusage = os.wait4(pid, 0)
+            elapsed = time.monotonic() - start
+        if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+            sys.exit('gbolt failed: %s' % ' '.join(args))
+        patterns = 0
+        for path in glob.glob(output + '.t*'):
+            with open(path) as out:
+                patterns += sum(1 for line in out if line.startswith('t #'))
+    # ru_maxrss is in kilobytes on Linux
+    return elapsed, rusage.ru_maxrss, patterns
+
+
+def measure(gbolt, root, run, repeat):
+    """Best of repeat runs, which is the least noisy on shared machines."""
+    data = os.path.join(root, run['dataset'])
+    best = None
+    for _ in range(repeat):
+        elapsed, memory, patterns = run_gbolt(gbolt, data, run['support'], run['threads'])
+        if best is None or elapsed < best['time']:
+            best = {'time': elapsed, 'memory_kb': memory, 'patterns': patterns}
+    best['throughput'] = round(best['patterns'] / max(best['time'], 1e-9), 1)
+    best['time'] = round(best['time'], 4)
+    result = {key: run[key] for key in ('dataset', 'support', 'threads')}
+    result.update(best)
+    return result
+
+
+def compare(result, expected, tolerance):
+    """Returns a list of regressions of result against expected."""
+    errors = []
+    if result['patterns'] != expected['patterns']:
+        errors.append('patterns %d != %d' % (result['patterns'], expected['patterns']))
+    max_time = expected['time'] * (1.0 + tolerance['time']) + tolerance['time_slack']
+    if result['time'] > max_time:
+        errors.append('time %.3fs > %.3fs' % (result['time'], max_time))
+    max_memory = expected['memory_kb'] * (1.0 + tolerance['memory'])
+    if result['memory_kb'] > max_memory:
+        errors.append('memory %dkb > %dkb' % (result['memory_kb'], max_memory))
+    return errors
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description='gBolt performance regression check')
+    parser.add_argument('--gbolt', default=os.path.join(root, 'build', 'gbolt'))
+    parser.add_argument('--baseline', default=os.path.join(root, 'scripts', 'perf_baseline.json'))
+    parser.add_argument('--data', default=os.path.join(root, 'extern', 'data'))
+    parser.add_argument('--output', default='perf_results.json')
+    parser.add_argument('--repeat', type=int, default=3)
+    parser.add_argument('--update', action='store_true', help='rewrite the baseline with this run')
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    tolerance = baseline['tolerance']
+
+    results = []
+    failed = False
+    for run in baseline['runs']:
+        result = measure(os.path.abspath(args.gbolt), args.data, run, args.repeat)
+        results.append(result)
+        errors = [] if args.update else compare(result, run, tolerance)
+        failed = failed or bool(errors)
+        print('%-14s s=%-5g t=%-3d %8.3fs %9dkb %8d patterns %10.0f/s  %s' % (
+            result['dataset'], result['support'], result['threads'], result['time'],
+            result['memory_kb'], result['patterns'], result['throughput'],
+            'FAIL: ' + ', '.join(errors) if errors else 'ok'))
+
+    with open(args.output, 'w') as f:
+        json.dump({'runs': results}, f, indent=2)
+        f.write('\n')
+
+    if args.update:
+        baseline['runs'] = results
+        with open(args.baseline, 'w') as f:
+            json.dump(baseline, f, indent=2)
+            f.write('\n')
+        print('baseline updated: %s' % args.baseline)
+    elif failed:
+        print('performance regression detected, results in %s' % args.output)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
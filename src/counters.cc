@@ -0,0 +1,136 @@
+#include <counters.h>
+#include <cerrno>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gbolt {
+
+const char *counter_phase_name(int phase) {
+  static const char *names[NPHASES] = {
+    "read", "construct", "project", "enumerate", "is_min", "report"
+  };
+  return names[phase];
+}
+
+PerfCounters::PerfCounters() : attempted_(false), last_enabled_(0), last_running_(0) {
+  for (int event = 0; event < NEVENTS; ++event) {
+    fds_[event] = -1;
+    last_[event] = 0;
+  }
+  for (int phase = 0; phase < NPHASES; ++phase) {
+    calls_[phase] = 0;
+    for (int event = 0; event < NEVENTS; ++event) {
+      counts_[phase][event] = 0;
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  #ifdef __linux__
+  for (int event = 0; event < NEVENTS; ++event) {
+    if (fds_[event] != -1) {
+      close(fds_[event]);
+    }
+  }
+  #endif
+}
+
+#ifdef __linux__
+static int perf_event_open(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  // User space only, which unprivileged processes may count
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP |
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // The calling thread on any cpu
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+bool PerfCounters::open(std::string &error) {
+  attempted_ = true;
+  #ifdef __linux__
+  // Generalized events, the kernel maps cache misses to the last level cache
+  static const uint64_t configs[NEVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+  fds_[EVENT_CYCLES] = perf_event_open(configs[EVENT_CYCLES], -1);
+  if (fds_[EVENT_CYCLES] == -1) {
+    error = strerror(errno);
+    return false;
+  }
+  events_.push_back(EVENT_CYCLES);
+  for (int event = EVENT_CYCLES + 1; event < NEVENTS; ++event) {
+    fds_[event] = perf_event_open(configs[event], fds_[EVENT_CYCLES]);
+    if (fds_[event] != -1) {
+      events_.push_back(event);
+    }
+  }
+  return true;
+  #else
+  error = "perf_event_open is only available on Linux";
+  return false;
+  #endif
+}
+
+void PerfCounters::begin(counter_phase_t phase) {
+  if (!attempted_) {
+    std::string error;
+    open(error);
+  }
+  if (!opened()) {
+    return;
+  }
+  accumulate();
+  phases_.push_back(phase);
+  ++calls_[phase];
+}
+
+void PerfCounters::end() {
+  if (!opened()) {
+    return;
+  }
+  accumulate();
+  phases_.pop_back();
+}
+
+void PerfCounters::accumulate() {
+  #ifdef __linux__
+  // nr, time enabled, time running and one value per event
+  uint64_t values[3 + NEVENTS];
+  const ssize_t size = (3 + events_.size()) * sizeof(uint64_t);
+  if (read(fds_[EVENT_CYCLES], values, size) != size) {
+    return;
+  }
+  const uint64_t enabled = values[1] - last_enabled_;
+  const uint64_t running = values[2] - last_running_;
+  last_enabled_ = values[1];
+  last_running_ = values[2];
+  for (size_t i = 0; i < events_.size(); ++i) {
+    const int event = events_[i];
+    uint64_t delta = values[3 + i] - last_[event];
+    last_[event] = values[3 + i];
+    // The group only ran for part of the time when multiplexed
+    if (running != 0 && running < enabled) {
+      delta = static_cast<uint64_t>(static_cast<double>(delta) * enabled / running);
+    }
+    if (!phases_.empty()) {
+      counts_[phases_.back()][event] += delta;
+    }
+  }
+  #endif
+}
+
+}  // namespace gbolt
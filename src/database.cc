@@ -1,23 +1,20 @@
 #include <database.h>
 #include <graph.h>
 #include <common.h>
-#include <fstream>
+#include <input.h>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <cstdint>
 
 namespace gbolt {
 
 void Database::read_input(const std::string &input_file, const std::string &separator) {
-  std::ifstream fin(input_file);
+  InputReader reader(input_file);
+  std::string line;
 
-  if (!fin.is_open()) {
-    LOG_ERROR("Open file error! %s", input_file.c_str());
-  }
-
-  char line[FILE_MAX_LINE];
-
-  while (fin.getline(line, FILE_MAX_LINE)) {
-    char *pch = strtok(line, separator.c_str());
+  while (reader.getline(line)) {
+    char *pch = strtok(&line[0], separator.c_str());
 
     // Empty line, just skip
     if (!pch) continue;
@@ -31,7 +28,8 @@ void Database::read_input(const std::string &input_file, const std::string &sepa
         // Discard the '#' character
         strtok(nullptr, separator.c_str());
         int id = atoi(strtok(nullptr, separator.c_str()));
-        input_graphs_.emplace_back(id);
+        const char *graph_class = strtok(nullptr, separator.c_str());
+        input_graphs_.emplace_back(id, graph_class ? atoi(graph_class) : 0);
         break;
       }
       case 'v': {
@@ -54,50 +52,117 @@ void Database::read_input(const std::string &input_file, const std::string &sepa
 }
 
 // Construct graph by labels
+template <typename W>
 void Database::construct_graphs(
-  const std::unordered_map<int, std::vector<int> > &frequent_vertex_labels,
-  const std::unordered_map<int, int> &frequent_edge_labels,
-  std::vector<Graph> &graphs) {
+  const std::unordered_map<int, int> &vertex_label_ids,
+  const std::unordered_map<int, int> &edge_label_ids,
+  int triple_support,
+  std::vector<BasicGraph<W> > &graphs) {
 
   graphs.reserve(input_graphs_.size());
 
-  std::unordered_map<int, int> id_map;
+  // Dense label of every input vertex and edge of a graph, -1 if infrequent
+  std::vector<int> labels;
+  std::vector<int> edge_labels;
+  auto relabel = [&](const input_graph &input_graph) {
+    labels.clear();
+    for (const auto& vert : input_graph.vertices) {
+      auto it = vertex_label_ids.find(vert.label);
+      labels.push_back(it != vertex_label_ids.end() ? it->second : -1);
+    }
+    edge_labels.clear();
+    for (const auto& edge : input_graph.edges) {
+      auto it = edge_label_ids.find(edge.label);
+      edge_labels.push_back(it != edge_label_ids.end() &&
+        labels[edge.from] != -1 && labels[edge.to] != -1 ? it->second : -1);
+    }
+  };
+
+  // A triple is the first DFS code of its edge, with the lesser vertex label
+  // first, and is frequent if enough graphs contain it
+  const uint64_t nvertex_labels = vertex_label_ids.size();
+  const uint64_t nedge_labels = edge_label_ids.size();
+  auto triple = [&](const input_edge &edge, int edge_label) {
+    const uint64_t from_label = labels[edge.from];
+    const uint64_t to_label = labels[edge.to];
+    return (std::min(from_label, to_label) * nedge_labels + edge_label) * nvertex_labels +
+      std::max(from_label, to_label);
+  };
+  const bool prune_triples = triple_support > 1;
+  std::unordered_map<uint64_t, int> triple_graphs;
+  if (prune_triples) {
+    std::vector<uint64_t> triples;
+    for (const auto& input_graph : input_graphs_) {
+      relabel(input_graph);
+      triples.clear();
+      for (size_t j = 0; j < input_graph.edges.size(); ++j) {
+        if (edge_labels[j] != -1) {
+          triples.push_back(triple(input_graph.edges[j], edge_labels[j]));
+        }
+      }
+      std::sort(triples.begin(), triples.end());
+      triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+      for (auto key : triples) {
+        ++triple_graphs[key];
+      }
+    }
+  }
+
+  std::vector<int> id_map;
+  std::vector<basic_edge_t<W> > edges;
+  size_t nedges = 0;
+  size_t nvertice = 0;
 
   for (const auto& input_graph : input_graphs_) {
+    relabel(input_graph);
     graphs.emplace_back();
 
-    auto& vertice = graphs.back().vertice;
-    vertice.reserve(input_graph.vertices.size());
+    // Keep the edges of frequent triples, and the vertices they connect
+    id_map.assign(input_graph.vertices.size(), -1);
+    for (size_t j = 0; j < input_graph.edges.size(); ++j) {
+      const input_edge &edge = input_graph.edges[j];
+      if (edge_labels[j] != -1 && prune_triples &&
+        triple_graphs[triple(edge, edge_labels[j])] < triple_support) {
+        edge_labels[j] = -1;
+      }
+      if (edge_labels[j] != -1) {
+        id_map[edge.from] = 0;
+        id_map[edge.to] = 0;
+      }
+    }
 
+    auto& vertice = graphs.back().vertice;
     int vertex_id = 0;
     for (const auto& vert : input_graph.vertices) {
-      if (frequent_vertex_labels.find(vert.label)
-        != frequent_vertex_labels.end()) {
+      if (id_map[vert.id] != -1) {
         id_map[vert.id] = vertex_id;
-        vertice.emplace_back(vertex_id++, vert.label);
+        vertice.emplace_back(vertex_id++, labels[vert.id]);
       }
     }
 
     int edge_id = 0;
-    for (const auto& edge : input_graph.edges) {
-      const int label_from = input_graph.vertices[edge.from].label;
-      const int label_to = input_graph.vertices[edge.to].label;
-      if (frequent_vertex_labels.find(label_from) != frequent_vertex_labels.end() &&
-        frequent_vertex_labels.find(label_to) != frequent_vertex_labels.end() &&
-        frequent_edge_labels.find(edge.label) != frequent_edge_labels.end()) {
-        const int to = id_map[edge.to];
-        const int from = id_map[edge.from];
-        vertice[from].edges.emplace_back(from, edge.label, to, edge_id);
-        vertice[to  ].edges.emplace_back(to, edge.label, from, edge_id);
-        ++edge_id;
+    edges.clear();
+    for (size_t j = 0; j < input_graph.edges.size(); ++j) {
+      const input_edge &edge = input_graph.edges[j];
+      if (edge_labels[j] != -1) {
+        edges.emplace_back(id_map[edge.from], edge_labels[j], id_map[edge.to], edge_id++);
       }
     }
 
     graphs.back().id = input_graph.id;
-    graphs.back().nedges = edge_id;
-
-    id_map.clear();
+    graphs.back().build_edges(edges);
+    nedges += input_graph.edges.size() - edges.size();
+    nvertice += input_graph.vertices.size() - vertice.size();
   }
+
+  #ifdef GBOLT_PERFORMANCE
+  LOG_INFO("gbolt pruned %zu edges and %zu vertices", nedges, nvertice);
+  #endif
 }
 
+template void Database::construct_graphs(const std::unordered_map<int, int> &,
+  const std::unordered_map<int, int> &, int, std::vector<BasicGraph<narrow_width_t> > &);
+template void Database::construct_graphs(const std::unordered_map<int, int> &,
+  const std::unordered_map<int, int> &, int, std::vector<BasicGraph<wide_width_t> > &);
+
 }  // namespace gbolt
@@ -0,0 +1,427 @@
+#include <gaston.h>
+#include <graph.h>
+#include <algorithm>
+#include <functional>
+
+namespace gbolt {
+
+// Keys are byte strings of fixed width integers, so that every encoding below
+// can be parsed back and equal keys mean equal patterns
+static void append_int(std::string &key, int value) {
+  key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::vector<std::vector<gaston_edge_t> > GastonPattern::adjacency() const {
+  std::vector<int> degrees(labels.size(), 0);
+  for (const auto& edge : edges) {
+    ++degrees[edge.from];
+    ++degrees[edge.to];
+  }
+  std::vector<std::vector<gaston_edge_t> > adjacency(labels.size());
+  for (size_t i = 0; i < labels.size(); ++i) {
+    adjacency[i].reserve(degrees[i]);
+  }
+  for (const auto& edge : edges) {
+    adjacency[edge.from].push_back(gaston_edge_t{edge.from, edge.to, edge.label});
+    adjacency[edge.to].push_back(gaston_edge_t{edge.to, edge.from, edge.label});
+  }
+  return adjacency;
+}
+
+GastonPattern::shape_t GastonPattern::shape() const {
+  // Patterns are connected
+  if (edges.size() + 1 != labels.size()) {
+    return CYCLIC;
+  }
+  std::vector<int> degrees(labels.size(), 0);
+  for (const auto& edge : edges) {
+    if (++degrees[edge.from] > 2 || ++degrees[edge.to] > 2) {
+      return TREE;
+    }
+  }
+  return PATH;
+}
+
+std::string GastonPattern::key() const {
+  switch (shape()) {
+    case PATH:
+      return path_key();
+    case TREE:
+      return tree_key();
+    default:
+      return cyclic_key();
+  }
+}
+
+bool GastonPattern::canonical_parent(const std::string &parent_key) const {
+  const std::vector<int> eccentricities = this->eccentricities();
+  const int diameter = *std::max_element(eccentricities.begin(), eccentricities.end());
+  if (eccentricities.back() != diameter) {
+    return false;
+  }
+  // Labels of each leaf and of its edge, keys are only compared on ties
+  const int last = labels.size() - 1;
+  std::vector<int> degrees(labels.size(), 0);
+  std::vector<int> edge_labels(labels.size());
+  for (const auto& edge : edges) {
+    ++degrees[edge.from];
+    ++degrees[edge.to];
+    edge_labels[edge.from] = edge_labels[edge.to] = edge.label;
+  }
+  std::vector<int> ties;
+  for (int leaf = 0; leaf < last; ++leaf) {
+    if (degrees[leaf] != 1 || eccentricities[leaf] != diameter) {
+      continue;
+    }
+    if (labels[leaf] != labels[last]) {
+      if (labels[leaf] < labels[last]) {
+        return false;
+      }
+    } else if (edge_labels[leaf] != edge_labels[last]) {
+      if (edge_labels[leaf] < edge_labels[last]) {
+        return false;
+      }
+    } else {
+      ties.push_back(leaf);
+    }
+  }
+  for (auto leaf : ties) {
+    if (without_leaf(leaf).key() < parent_key) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<bool> GastonPattern::leaf_parents() const {
+  const std::vector<int> eccentricities = this->eccentricities();
+  const int diameter = *std::max_element(eccentricities.begin(), eccentricities.end());
+  std::vector<bool> leaf_parents(labels.size());
+  for (size_t i = 0; i < labels.size(); ++i) {
+    leaf_parents[i] = eccentricities[i] + 1 >= diameter;
+  }
+  return leaf_parents;
+}
+
+// Distance of every vertex of a tree to source
+static std::vector<int> tree_distances(
+  const std::vector<std::vector<gaston_edge_t> > &adjacency, int source) {
+  std::vector<int> distances(adjacency.size(), -1);
+  std::vector<int> queue;
+  queue.reserve(adjacency.size());
+  queue.push_back(source);
+  distances[source] = 0;
+  for (size_t head = 0; head < queue.size(); ++head) {
+    const int vertex = queue[head];
+    for (const auto& edge : adjacency[vertex]) {
+      if (distances[edge.to] < 0) {
+        distances[edge.to] = distances[vertex] + 1;
+        queue.push_back(edge.to);
+      }
+    }
+  }
+  return distances;
+}
+
+std::vector<int> GastonPattern::eccentricities() const {
+  // The farthest vertex from any vertex of a tree ends a longest path, and the
+  // farthest vertex from a vertex of a tree is one of the ends of a longest path
+  const auto adjacency = this->adjacency();
+  std::vector<int> first = tree_distances(adjacency, 0);
+  const int first_end = std::max_element(first.begin(), first.end()) - first.begin();
+  first = tree_distances(adjacency, first_end);
+  const int second_end = std::max_element(first.begin(), first.end()) - first.begin();
+  const std::vector<int> second = tree_distances(adjacency, second_end);
+  for (size_t i = 0; i < first.size(); ++i) {
+    first[i] = std::max(first[i], second[i]);
+  }
+  return first;
+}
+
+GastonPattern GastonPattern::without_leaf(int leaf) const {
+  GastonPattern pattern;
+  pattern.labels = labels;
+  pattern.labels.erase(pattern.labels.begin() + leaf);
+  for (const auto& edge : edges) {
+    if (edge.from != leaf && edge.to != leaf) {
+      pattern.edges.push_back(gaston_edge_t{edge.from - (edge.from > leaf),
+        edge.to - (edge.to > leaf), edge.label});
+    }
+  }
+  return pattern;
+}
+
+std::string GastonPattern::path_key() const {
+  const auto adjacency = this->adjacency();
+  int vertex = 0;
+  while (adjacency[vertex].size() != 1) {
+    ++vertex;
+  }
+  // Vertex and edge labels alternate from one end to the other
+  std::vector<int> sequence{labels[vertex]};
+  int prev = -1;
+  while (true) {
+    const gaston_edge_t *next = nullptr;
+    for (const auto& edge : adjacency[vertex]) {
+      if (edge.to != prev) {
+        next = &edge;
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    sequence.push_back(next->label);
+    sequence.push_back(labels[next->to]);
+    prev = vertex;
+    vertex = next->to;
+  }
+  std::vector<int> reversed(sequence.rbegin(), sequence.rend());
+  const std::vector<int> &min_sequence = std::min(sequence, reversed);
+
+  std::string key("P");
+  for (auto value : min_sequence) {
+    append_int(key, value);
+  }
+  return key;
+}
+
+std::string GastonPattern::tree_key() const {
+  const auto adjacency = this->adjacency();
+  const int nvertice = labels.size();
+
+  // Strip leaves layer by layer, one or two centers remain
+  std::vector<int> degrees(nvertice);
+  std::vector<int> leaves;
+  for (int i = 0; i < nvertice; ++i) {
+    degrees[i] = adjacency[i].size();
+    if (degrees[i] == 1) {
+      leaves.push_back(i);
+    }
+  }
+  int remaining = nvertice;
+  while (remaining > 2) {
+    std::vector<int> next_leaves;
+    for (auto leaf : leaves) {
+      --remaining;
+      for (const auto& edge : adjacency[leaf]) {
+        if (--degrees[edge.to] == 1) {
+          next_leaves.push_back(edge.to);
+        }
+      }
+    }
+    leaves.swap(next_leaves);
+  }
+
+  // A vertex is encoded by its label, its number of children and the sorted
+  // encodings of its children, each after the label of the edge leading to it
+  std::function<std::string(int, int)> encode = [&](int vertex, int parent) {
+    std::vector<std::string> children;
+    for (const auto& edge : adjacency[vertex]) {
+      if (edge.to != parent) {
+        std::string child;
+        append_int(child, edge.label);
+        children.push_back(child + encode(edge.to, vertex));
+      }
+    }
+    std::sort(children.begin(), children.end());
+    std::string code;
+    append_int(code, labels[vertex]);
+    append_int(code, children.size());
+    for (const auto& child : children) {
+      code += child;
+    }
+    return code;
+  };
+
+  if (leaves.size() == 1) {
+    return "T" + encode(leaves[0], -1);
+  }
+  // Two centers: both halves of the central edge, in order
+  int edge_label = 0;
+  for (const auto& edge : adjacency[leaves[0]]) {
+    if (edge.to == leaves[1]) {
+      edge_label = edge.label;
+    }
+  }
+  std::string first = encode(leaves[0], leaves[1]);
+  std::string second = encode(leaves[1], leaves[0]);
+  if (second < first) {
+    first.swap(second);
+  }
+  std::string key("U");
+  append_int(key, edge_label);
+  return key + first + second;
+}
+
+// A DFS code of a pattern being built by min_dfs_codes
+struct gaston_dfs_state_t {
+  // Pattern vertex of each DFS id
+  std::vector<int> vertice;
+  // DFS id of each pattern vertex, -1 if not discovered yet
+  std::vector<int> dfs_ids;
+  // Pattern edges already in the code, as an adjacency matrix
+  std::vector<bool> used;
+};
+
+// gSpan order of two extensions of the same code: backward before forward
+static bool extension_less(const wide_dfs_code_t &first, const wide_dfs_code_t &second) {
+  const bool first_backward = first.from > first.to;
+  const bool second_backward = second.from > second.to;
+  if (first_backward != second_backward) {
+    return first_backward;
+  }
+  if (first_backward) {
+    return dfs_code_backward_compare_t()(first, second);
+  }
+  return dfs_code_forward_compare_t()(first, second);
+}
+
+std::vector<wide_dfs_code_t> GastonPattern::min_dfs_codes() const {
+  const auto adjacency = this->adjacency();
+  const int nvertice = labels.size();
+
+  // Every directed edge with the minimum labels starts a candidate code
+  wide_dfs_code_t min_code{0, 1, 0, 0, 0};
+  bool found = false;
+  for (const auto& edge : edges) {
+    for (int side = 0; side < 2; ++side) {
+      const int from = side == 0 ? edge.from : edge.to;
+      const int to = side == 0 ? edge.to : edge.from;
+      wide_dfs_code_t code{0, 1, labels[from], edge.label, labels[to]};
+      if (!found || dfs_code_project_compare_t()(code, min_code)) {
+        min_code = code;
+        found = true;
+      }
+    }
+  }
+  std::vector<gaston_dfs_state_t> states;
+  for (const auto& edge : edges) {
+    for (int side = 0; side < 2; ++side) {
+      const int from = side == 0 ? edge.from : edge.to;
+      const int to = side == 0 ? edge.to : edge.from;
+      wide_dfs_code_t code{0, 1, labels[from], edge.label, labels[to]};
+      if (code == min_code) {
+        gaston_dfs_state_t state;
+        state.vertice = {from, to};
+        state.dfs_ids.assign(nvertice, -1);
+        state.dfs_ids[from] = 0;
+        state.dfs_ids[to] = 1;
+        state.used.assign(nvertice * nvertice, false);
+        state.used[from * nvertice + to] = state.used[to * nvertice + from] = true;
+        states.push_back(std::move(state));
+      }
+    }
+  }
+  std::vector<wide_dfs_code_t> codes{min_code};
+  // DFS id of the parent of each DFS id along forward codes
+  std::vector<int> parents{-1, 0};
+
+  // Extend all candidates by the minimum extension, keeping those that have it
+  // with the candidate and pattern vertex of each
+  wide_dfs_code_t next_code;
+  std::vector<std::pair<size_t, int> > targets;
+  const auto offer = [&](const wide_dfs_code_t &extension, size_t i, int to) {
+    if (targets.empty() || extension_less(extension, next_code)) {
+      next_code = extension;
+      targets.clear();
+    } else if (extension != next_code) {
+      return;
+    }
+    targets.emplace_back(i, to);
+  };
+  std::vector<bool> on_path;
+  std::vector<gaston_dfs_state_t> next_states;
+  while (codes.size() < edges.size()) {
+    const int rightmost = parents.size() - 1;
+    on_path.assign(parents.size(), false);
+    for (int id = rightmost; id >= 0; id = parents[id]) {
+      on_path[id] = true;
+    }
+
+    targets.clear();
+    for (size_t i = 0; i < states.size(); ++i) {
+      const gaston_dfs_state_t &state = states[i];
+      const int last = state.vertice[rightmost];
+      for (const auto& edge : adjacency[last]) {
+        const int to_id = state.dfs_ids[edge.to];
+        if (to_id >= 0 && on_path[to_id] && !state.used[last * nvertice + edge.to]) {
+          offer(wide_dfs_code_t{rightmost, to_id, labels[last], edge.label, labels[edge.to]},
+            i, edge.to);
+        }
+      }
+      for (int id = rightmost; id >= 0; id = parents[id]) {
+        const int vertex = state.vertice[id];
+        for (const auto& edge : adjacency[vertex]) {
+          if (state.dfs_ids[edge.to] < 0) {
+            offer(wide_dfs_code_t{id, rightmost + 1, labels[vertex], edge.label,
+              labels[edge.to]}, i, edge.to);
+          }
+        }
+      }
+    }
+
+    // The last extension of a candidate takes it instead of a copy
+    next_states.clear();
+    for (size_t j = 0; j < targets.size(); ++j) {
+      const size_t i = targets[j].first;
+      gaston_dfs_state_t state = j + 1 < targets.size() && targets[j + 1].first == i ?
+        states[i] : std::move(states[i]);
+      const int from = state.vertice[next_code.from];
+      const int to = targets[j].second;
+      state.used[from * nvertice + to] = state.used[to * nvertice + from] = true;
+      if (next_code.from < next_code.to) {
+        state.dfs_ids[to] = next_code.to;
+        state.vertice.push_back(to);
+      }
+      next_states.push_back(std::move(state));
+    }
+    states.swap(next_states);
+    if (next_code.from < next_code.to) {
+      parents.push_back(next_code.from);
+    }
+    codes.push_back(next_code);
+  }
+  return codes;
+}
+
+std::string GastonPattern::cyclic_key() const {
+  std::string key("C");
+  for (const auto& code : min_dfs_codes()) {
+    append_int(key, code.from);
+    append_int(key, code.to);
+    append_int(key, code.from_label);
+    append_int(key, code.edge_label);
+    append_int(key, code.to_label);
+  }
+  return key;
+}
+
+GastonKeys::GastonKeys() {
+  #ifndef GBOLT_SERIAL
+  for (auto& lock : locks_) {
+    omp_init_lock(&lock);
+  }
+  #endif
+}
+
+GastonKeys::~GastonKeys() {
+  #ifndef GBOLT_SERIAL
+  for (auto& lock : locks_) {
+    omp_destroy_lock(&lock);
+  }
+  #endif
+}
+
+bool GastonKeys::insert(const std::string &key) {
+  const size_t shard = std::hash<std::string>()(key) % nshards;
+  #ifndef GBOLT_SERIAL
+  omp_set_lock(&locks_[shard]);
+  #endif
+  const bool inserted = shards_[shard].insert(key).second;
+  #ifndef GBOLT_SERIAL
+  omp_unset_lock(&locks_[shard]);
+  #endif
+  return inserted;
+}
+
+}  // namespace gbolt
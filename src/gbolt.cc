@@ -1,17 +1,40 @@
 #include <gbolt.h>
 #include <common.h>
 #include <cxxopts.hpp>
+#include <algorithm>
+#include <vector>
 
 int main(int argc, char *argv[]) {
   cxxopts::Options options("gBolt", "very fast implementation for gSpan algorithm in data mining");
   options.add_options()
     ("i,input", "Input path of graph data", cxxopts::value<std::string>())
     ("o,output", "Output gbolt mining results", cxxopts::value<std::string>()->default_value(""))
-    ("s,support", "Minimum subgraph frequency: (0.0, 1.0]", cxxopts::value<double>()->default_value("1.0"))
+    ("s,support", "Minimum subgraph frequency: (0.0, 1.0], a comma separated list saves one output set per support", cxxopts::value<std::vector<double> >()->default_value("1.0"))
     ("m,mark", "Graph data separator", cxxopts::value<std::string>()->default_value(" "))
     ("p,parents", "Output subgraph parent ids")
     ("d,dfs", "Output subgraph dfs patterns")
     ("n,nodes", "Output frequent nodes")
+    ("t,trace", "Output mining task timeline in Chrome trace-event format", cxxopts::value<std::string>()->default_value(""))
+    ("e,embedding-free", "Keep only supporting graph ids and re-embed patterns on demand")
+    ("embedding-threshold", "Switch to embedding-free mining above this many embeddings per graph, 0 never switches", cxxopts::value<double>()->default_value("0"))
+    ("state-in", "Incremental mining: state of an earlier run, whose graphs are the first input graphs", cxxopts::value<std::string>()->default_value(""))
+    ("state-out", "Save the mining state for later incremental runs", cxxopts::value<std::string>()->default_value(""))
+    ("border", "Keep patterns with this support in the saved state: (0.0, support], defaults to the loaded border or the support", cxxopts::value<double>()->default_value("0"))
+    ("mni", "Mine a single large graph, with minimum image based support of at least this many vertices instead of -s", cxxopts::value<int>()->default_value("0"))
+    ("engine", "Mining engine: gspan, or gaston to mine paths, then trees, then cyclic patterns", cxxopts::value<std::string>()->default_value("gspan"))
+    ("merge-output", "Save a single output file with thread independent pattern ids, ordered by DFS code")
+    ("sample", "Approximate mining: mine this fraction of the graphs, (0.0, 1.0), and verify the candidates in all graphs", cxxopts::value<double>()->default_value("0"))
+    ("sample-delta", "Probability of missing each frequent pattern with --sample: (0.0, 1.0)", cxxopts::value<double>()->default_value("0.05"))
+    ("sample-max-lowering", "Largest fraction the support of the sample is lowered by, --sample fails if --sample-delta needs more: (0.0, 1.0)", cxxopts::value<double>()->default_value("0.2"))
+    ("sample-seed", "Random seed of the sample", cxxopts::value<unsigned int>()->default_value("0"))
+    ("query", "Count the supports of the patterns of an output file saved with -d instead of mining", cxxopts::value<std::string>()->default_value(""))
+    ("target-class", "Discriminative mining: graphs have a class after their id on t # lines, and -s is the support within this class", cxxopts::value<int>()->default_value("-1"))
+    ("max-other", "With --target-class, keep patterns supported by at most this fraction of the other graphs", cxxopts::value<double>()->default_value("1.0"))
+    ("min-score", "With --target-class, keep patterns whose support in the class exceeds the one in the others by this much: [-1.0, 1.0], -1 only filters by --max-other", cxxopts::value<double>()->default_value("-1"))
+    ("collapse-duplicates", "Mine a single graph of every set of isomorphic input graphs, weighted by the size of the set")
+    ("counters", "Count cycles, instructions, last level cache and branch misses of each phase with perf_event_open")
+    ("progress", "Report progress every this many seconds while mining, 0 never reports", cxxopts::value<double>()->default_value("0"))
+    ("progress-file", "With --progress, write the progress into this status file instead of the log", cxxopts::value<std::string>()->default_value(""))
     ("h,help", "gBolt help");
 
   if (argc == 1) {
@@ -28,24 +51,154 @@ int main(int argc, char *argv[]) {
 
   const std::string input = result["input"].as<std::string>();
   const std::string output = result["output"].as<std::string>();
-  double support = result["support"].as<double>();
+  const std::vector<double> supports = result["support"].as<std::vector<double> >();
   const std::string mark = result["mark"].as<std::string>();
   bool parents = result["parents"].as<bool>();
   bool dfs = result["dfs"].as<bool>();
   bool nodes = result["nodes"].as<bool>();
+  const std::string trace = result["trace"].as<std::string>();
+  bool embedding_free = result["embedding-free"].as<bool>();
+  double embedding_threshold = result["embedding-threshold"].as<double>();
+  int mni = result["mni"].as<int>();
+  const std::string state_in = result["state-in"].as<std::string>();
+  const std::string state_out = result["state-out"].as<std::string>();
+  double border = result["border"].as<double>();
+  const std::string engine = result["engine"].as<std::string>();
+  bool merge_output = result["merge-output"].as<bool>();
+  double sample = result["sample"].as<double>();
+  double sample_delta = result["sample-delta"].as<double>();
+  double sample_max_lowering = result["sample-max-lowering"].as<double>();
+  unsigned int sample_seed = result["sample-seed"].as<unsigned int>();
+  const std::string query = result["query"].as<std::string>();
+  int target_class = result["target-class"].as<int>();
+  double max_other = result["max-other"].as<double>();
+  double min_score = result["min-score"].as<double>();
+  bool collapse = result["collapse-duplicates"].as<bool>();
+  bool counters = result["counters"].as<bool>();
+  double progress = result["progress"].as<double>();
+  const std::string progress_file = result["progress-file"].as<std::string>();
 
-  if (support > 1.0 || support <= 0.0) {
+  if (supports.empty()) {
     LOG_ERROR("Support value should be less than 1.0 and greater than 0.0");
   }
+  for (auto support : supports) {
+    if (support > 1.0 || support <= 0.0) {
+      LOG_ERROR("Support value should be less than 1.0 and greater than 0.0");
+    }
+  }
+  // Mine once with the lowest support
+  const double support = *std::min_element(supports.begin(), supports.end());
+
+  if (embedding_threshold < 0.0) {
+    LOG_ERROR("Embedding threshold should not be negative");
+  }
+
+  if (mni < 0) {
+    LOG_ERROR("Minimum image based support should not be negative");
+  }
+
+  if (mni > 0 && supports.size() > 1) {
+    LOG_ERROR("Minimum image based support cannot be combined with a list of supports");
+  }
+
+  if (mni > 0 && (embedding_free || embedding_threshold > 0.0)) {
+    LOG_ERROR("Minimum image based support needs embeddings, it cannot be mined embedding-free");
+  }
+
+  if (border < 0.0 || border > support) {
+    LOG_ERROR("Border should not be negative or greater than the support");
+  }
+
+  const bool incremental = state_in.size() != 0 || state_out.size() != 0;
+  if (incremental && (mni > 0 || embedding_free || embedding_threshold > 0.0)) {
+    LOG_ERROR("Incremental mining cannot be combined with minimum image based support or embedding-free mining");
+  }
+
+  if (engine != "gspan" && engine != "gaston") {
+    LOG_ERROR("Unknown engine %s, use gspan or gaston", engine.c_str());
+  }
+
+  const bool gaston = engine == "gaston";
+  if (gaston && (incremental || mni > 0 || embedding_free || embedding_threshold > 0.0)) {
+    LOG_ERROR("The gaston engine cannot be combined with incremental, minimum image based or embedding-free mining");
+  }
+
+  if (sample < 0.0 || sample >= 1.0) {
+    LOG_ERROR("Sample fraction should be less than 1.0 and not negative");
+  }
+
+  if (sample_delta <= 0.0 || sample_delta >= 1.0) {
+    LOG_ERROR("Sample delta should be less than 1.0 and greater than 0.0");
+  }
+
+  if (sample_max_lowering <= 0.0 || sample_max_lowering >= 1.0) {
+    LOG_ERROR("Sample max lowering should be less than 1.0 and greater than 0.0");
+  }
+
+  if (sample > 0.0 && (incremental || mni > 0 || gaston || embedding_free || embedding_threshold > 0.0)) {
+    LOG_ERROR("Sampling cannot be combined with incremental, minimum image based, gaston or embedding-free mining");
+  }
+
+  if (query.size() != 0 && (incremental || mni > 0 || gaston || sample > 0.0 ||
+    embedding_free || embedding_threshold > 0.0)) {
+    LOG_ERROR("Queries cannot be combined with incremental, minimum image based, gaston, sampled or embedding-free mining");
+  }
+
+  if (target_class < -1) {
+    LOG_ERROR("Target class should be -1 (off) or a non-negative class");
+  }
+
+  if (max_other < 0.0 || max_other > 1.0 || min_score < -1.0 || min_score > 1.0) {
+    LOG_ERROR("Max other support should be in [0.0, 1.0] and min score in [-1.0, 1.0]");
+  }
+
+  if (target_class >= 0 && (incremental || mni > 0 || gaston || sample > 0.0 || query.size() != 0 ||
+    embedding_free || embedding_threshold > 0.0 || supports.size() > 1)) {
+    LOG_ERROR("Discriminative mining cannot be combined with incremental, minimum image based, gaston, sampled, embedding-free mining, queries or a list of supports");
+  }
+
+  if (collapse && (incremental || mni > 0 || gaston || sample > 0.0 || target_class >= 0)) {
+    LOG_ERROR("Collapsing duplicates cannot be combined with incremental, minimum image based, gaston, sampled or discriminative mining");
+  }
+
+  if (progress < 0.0) {
+    LOG_ERROR("Progress interval should not be negative");
+  }
+
+  if (progress_file.size() != 0 && progress == 0.0) {
+    LOG_ERROR("A progress file needs a progress interval");
+  }
 
   // Construct algorithm
   gbolt::GBolt gbolt(output, support);
+  if (trace.size() != 0) {
+    gbolt.enable_trace();
+  }
+  gbolt.set_embedding_free(embedding_free, embedding_threshold);
+  gbolt.set_mni(mni);
+  gbolt.set_incremental(state_in, state_out, border);
+  gbolt.set_output_supports(supports);
+  gbolt.set_gaston(gaston);
+  gbolt.set_merge_output(merge_output);
+  gbolt.set_sample(sample, sample_delta, sample_max_lowering, sample_seed);
+  gbolt.set_query(query);
+  gbolt.set_classes(target_class, max_other, min_score);
+  gbolt.set_collapse_duplicates(collapse);
+  gbolt.set_progress(progress, progress_file);
+  if (counters) {
+    // Counting is optional, a run without access to the counters goes on
+    std::string error;
+    if (!gbolt.enable_counters(error)) {
+      LOG_INFO("gbolt hardware counters unavailable, running without them: %s", error.c_str());
+    }
+  }
 
   // Read input
   gbolt.read_input(input, mark);
 
   // Execute algorithm
   gbolt.execute();
+  gbolt.report_counters();
 
   // Save results
   if (output.size() != 0) {
@@ -60,5 +213,10 @@ int main(int argc, char *argv[]) {
     LOG_INFO("gbolt save output time: %f", elapsed);
     #endif
   }
+
+  // Save task timeline
+  if (trace.size() != 0) {
+    gbolt.save_trace(trace);
+  }
   return 0;
 }
@@ -2,26 +2,171 @@
 #include <gbolt.h>
 #include <history.h>
 #include <algorithm>
+#include <bitset>
+#include <limits>
 
 namespace gbolt {
 
-int GBolt::count_support(const Projection &projection) {
-  int prev_id = -1;
-  int size = 0;
+template <typename W>
+int GBoltCore<W>::count_support(const Projection &projection) const {
+  // Every graph has exactly one run
+  if (graph_weights_.empty()) {
+    return projection.runs().size();
+  }
+  int support = 0;
+  for (const auto& run : projection.runs()) {
+    support += graph_weights_[run.id];
+  }
+  return support;
+}
+
+int GBoltBase::count_support(const std::vector<int> &graph_ids) const {
+  if (graph_weights_.empty()) {
+    return graph_ids.size();
+  }
+  int support = 0;
+  for (auto graph_id : graph_ids) {
+    support += graph_weights_[graph_id];
+  }
+  return support;
+}
+
+template <typename W>
+void GBoltCore<W>::count_classes(const Projection &projection, int &ntarget, int &nother) const {
+  ntarget = 0;
+  for (const auto& run : projection.runs()) {
+    ntarget += graph_classes_[run.id] == target_class_;
+  }
+  nother = projection.runs().size() - ntarget;
+}
+
+void GBoltBase::count_classes(const std::vector<int> &graph_ids, int &ntarget, int &nother) const {
+  ntarget = 0;
+  for (auto graph_id : graph_ids) {
+    ntarget += graph_classes_[graph_id] == target_class_;
+  }
+  nother = graph_ids.size() - ntarget;
+}
+
+bool GBoltBase::discriminative(int ntarget, int nother) const {
+  const double target_support = static_cast<double>(ntarget) / std::max(ntarget_graphs_, 1);
+  const double other_support = static_cast<double>(nother) / std::max(nother_graphs_, 1);
+  return other_support <= max_other_ && target_support - other_support >= min_score_;
+}
+
+// Embeddings counted by each parallel task
+static const uint32_t mni_chunk_size = 1 << 14;
+
+// Calls f(pattern vertex, graph vertex) for every vertex of the index-th
+// embedding of the last level
+template <typename W, typename F>
+static inline void for_each_image(const BasicDfsCodes<W> &dfs_codes,
+  const std::vector<const Projection *> &levels, const BasicGraph<W> &graph,
+  uint32_t index, F f) {
+  for (auto level = levels.size(); level > 0; --level) {
+    const prev_dfs_t &prev_dfs = (*levels[level - 1])[index];
+    const basic_edge_t<W> &edge = graph.edges[prev_dfs.edge];
+    f(dfs_codes[level - 1]->from, edge.from);
+    f(dfs_codes[level - 1]->to, edge.to);
+    index = prev_dfs.prev;
+  }
+}
+
+template <typename W>
+int GBoltCore<W>::count_mni(const Projection &projection, const DfsCodes &dfs_codes,
+  const dfs_code_t &next_code) const {
+  // A vertex has at most one image per embedding
+  if (projection.size() < static_cast<uint32_t>(nsupport_)) {
+    return projection.size();
+  }
+
+  DfsCodes codes = dfs_codes;
+  codes.push_back(&next_code);
+  std::vector<const Projection *> levels(codes.size());
+  levels.back() = &projection;
+  for (auto level = levels.size() - 1; level > 0; --level) {
+    levels[level - 1] = levels[level]->parent();
+  }
+  int nvertice = 0;
+  for (const auto code : codes) {
+    nvertice = std::max(nvertice, std::max(code->from, code->to) + 1);
+  }
 
-  for (const auto& link : projection) {
-    if (prev_id != link.id) {
-      prev_id = link.id;
-      ++size;
+  const auto& runs = projection.runs();
+  const size_t nwords = (vertex_offsets_.back() + 63) / 64;
+  int nsupport = std::numeric_limits<int>::max();
+  if (nwords > projection.size()) {
+    // Clearing bitsets would cost more than sorting the images of each
+    // pattern vertex
+    std::vector<std::vector<size_t> > images(nvertice);
+    for (size_t run = 0; run < runs.size(); ++run) {
+      const Graph &graph = graphs_[runs[run].id];
+      const size_t offset = vertex_offsets_[graph.id];
+      for (auto i = runs[run].begin; i < projection.run_end(run); ++i) {
+        for_each_image(codes, levels, graph, i, [&](int pattern_vertex, int vertex) {
+          images[pattern_vertex].push_back(offset + vertex);
+        });
+      }
+    }
+    for (auto& vertex_images : images) {
+      std::sort(vertex_images.begin(), vertex_images.end());
+      const int nimages = std::unique(vertex_images.begin(), vertex_images.end()) -
+        vertex_images.begin();
+      nsupport = std::min(nsupport, nimages);
+    }
+    return nsupport;
+  }
+
+  // Mark the images of each pattern vertex in a bitset, shared by tasks
+  // counting chunks of the embeddings of one graph
+  std::vector<uint64_t> images(nvertice * nwords, 0);
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskgroup
+  #endif
+  {
+    for (size_t run = 0; run < runs.size(); ++run) {
+      const uint32_t run_end = projection.run_end(run);
+      for (auto begin = runs[run].begin; begin < run_end; begin += mni_chunk_size) {
+        const uint32_t end = std::min(run_end, begin + mni_chunk_size);
+        #ifndef GBOLT_SERIAL
+        #pragma omp task if(projection.size() > mni_chunk_size) shared(codes, levels, images, runs) firstprivate(run, begin, end)
+        #endif
+        {
+          const Graph &graph = graphs_[runs[run].id];
+          const size_t offset = vertex_offsets_[graph.id];
+          for (auto i = begin; i < end; ++i) {
+            for_each_image(codes, levels, graph, i, [&](int pattern_vertex, int vertex) {
+              const size_t image = offset + vertex;
+              uint64_t &word = images[pattern_vertex * nwords + image / 64];
+              const uint64_t mask = static_cast<uint64_t>(1) << (image % 64);
+              #ifndef GBOLT_SERIAL
+              #pragma omp atomic
+              #endif
+              word |= mask;
+            });
+          }
+        }
+      }
+    }
+  }
+  for (auto pattern_vertex = 0; pattern_vertex < nvertice; ++pattern_vertex) {
+    int nimages = 0;
+    for (size_t i = 0; i < nwords; ++i) {
+      nimages += std::bitset<64>(images[pattern_vertex * nwords + i]).count();
     }
+    nsupport = std::min(nsupport, nimages);
   }
-  return size;
+  return nsupport;
 }
 
-void gbolt_instance_t::build_min_graph(const DfsCodes &dfs_codes) {
+template <typename W>
+void basic_gbolt_instance_t<W>::build_min_graph(const DfsCodes &dfs_codes) {
+  // The history may still hold edges of the graph about to be rebuilt
+  history.clear();
   int edge_id = 0;
-  Vertice& vertice = min_graph.vertice;
+  auto& vertice = min_graph.vertice;
   vertice.clear();
+  min_edges.clear();
 
   // New size is just large enough to ensure no extra vertices at the end.
   // The max vertex id is either the last code's 'from' (if it is backwards),
@@ -36,16 +181,13 @@ void gbolt_instance_t::build_min_graph(const DfsCodes &dfs_codes) {
     vertice[edge->to].label = edge->to_label;
     vertice[edge->to].id = edge->to;
     // Push an edge
-    vertice[edge->from].edges.emplace_back(
-      edge->from, edge->edge_label, edge->to, edge_id);
-    vertice[edge->to].edges.emplace_back(
-      edge->to, edge->edge_label, edge->from, edge_id);
-    ++edge_id;
+    min_edges.emplace_back(edge->from, edge->edge_label, edge->to, edge_id++);
   }
-  min_graph.nedges = edge_id;
+  min_graph.build_edges(min_edges);
 }
 
-void gbolt_instance_t::update_right_most_path(const DfsCodes &dfs_codes, size_t size) {
+template <typename W>
+void basic_gbolt_instance_t<W>::update_right_most_path(const DfsCodes &dfs_codes, size_t size) {
   right_most_path.clear();
   int prev_id = -1;
 
@@ -65,7 +207,9 @@ void gbolt_instance_t::update_right_most_path(const DfsCodes &dfs_codes, size_t
   }
 }
 
-bool gbolt_instance_t::is_min(const DfsCodes &dfs_codes) {
+template <typename W>
+bool basic_gbolt_instance_t<W>::is_min(const DfsCodes &dfs_codes) {
+  PerfScope scope(counters, PHASE_IS_MIN);
   build_min_graph(dfs_codes);
   right_most_path = {0};
 
@@ -109,10 +253,11 @@ bool gbolt_instance_t::is_min(const DfsCodes &dfs_codes) {
   return is_projection_min(dfs_codes);
 }
 
-bool gbolt_instance_t::exists_backwards(const size_t projection_start_index) {
+template <typename W>
+bool basic_gbolt_instance_t<W>::exists_backwards(const size_t projection_start_index) {
   const size_t projection_end_index = min_projection.size();
   for (auto j = projection_start_index; j < projection_end_index; ++j) {
-    history.build_edges_min(min_projection, min_graph, j);
+    history.build_edges_min(min_projection, j);
     const edge_t& last_edge = history.get_edge(right_most_path[0]);
     const vertex_t& last_node = min_graph.vertice[last_edge.to];
     for (const auto& ln_edge : last_node.edges) {
@@ -133,7 +278,8 @@ bool gbolt_instance_t::exists_backwards(const size_t projection_start_index) {
   return false;
 }
 
-bool gbolt_instance_t::is_backward_min(
+template <typename W>
+bool basic_gbolt_instance_t<W>::is_backward_min(
   const DfsCodes& dfs_codes,
   const dfs_code_t &min_dfs_code,
   const size_t projection_start_index) {
@@ -142,7 +288,7 @@ bool gbolt_instance_t::is_backward_min(
   // i > 0, because a backward edge cannot go to the last vertex.
   const int from_id = dfs_codes[right_most_path[0]]->to;
   for (auto j = projection_start_index; j < projection_end_index; ++j) {
-    history.build_edges_min(min_projection, min_graph, j);
+    history.build_edges_min(min_projection, j);
 
     const edge_t& last_edge = history.get_edge(right_most_path[0]);
     const vertex_t& last_node = min_graph.vertice[last_edge.to];
@@ -177,7 +323,8 @@ bool gbolt_instance_t::is_backward_min(
   return true;
 }
 
-bool gbolt_instance_t::is_forward_min(
+template <typename W>
+bool basic_gbolt_instance_t<W>::is_forward_min(
   const DfsCodes& dfs_codes,
   const dfs_code_t &min_dfs_code,
   const size_t projection_start_index) {
@@ -186,7 +333,7 @@ bool gbolt_instance_t::is_forward_min(
 
   const int max_id = dfs_codes[right_most_path[0]]->to;
   for (auto i = projection_start_index; i < projection_end_index; ++i) {
-    history.build_vertice_min(min_projection, min_graph, i);
+    history.build_vertice_min(min_projection, i);
 
     const edge_t& last_edge = history.get_edge(right_most_path[0]);
     const vertex_t& last_node = min_graph.vertice[last_edge.to];
@@ -200,9 +347,11 @@ bool gbolt_instance_t::is_forward_min(
       if (dfs_code_forward_compare_t{}(dfs_code, min_dfs_code)) {
         return false;
       }
-      if (dfs_code == min_dfs_code) {
-        min_projection.emplace_back(ln_edge, i);
-      }
+      // Edges are sorted by (edge label, to label), so every later edge
+      // produces a larger DFS code.
+      if (dfs_code != min_dfs_code)
+        break;
+      min_projection.emplace_back(ln_edge, i);
     }
 
     // If the min_dfs_code is an extension from the rightmost vertex, we only
@@ -217,21 +366,23 @@ bool gbolt_instance_t::is_forward_min(
       const vertex_t& cur_node = min_graph.vertice[cur_edge.from];
       const vertex_t& cur_to = min_graph.vertice[cur_edge.to];
 
-      for (const auto& cn_edge : cur_node.edges) {
-        const vertex_t& to_node = min_graph.vertice[cn_edge.to];
+      // Skip the edges that are lexicographically less than the current one,
+      // the remaining edges produce increasing DFS codes.
+      const edge_t *cn_edge = min_graph.lower_bound(cur_node.edges.begin(),
+        cur_node.edges.end(), cur_edge.label, cur_to.label);
+      for (; cn_edge != cur_node.edges.end(); ++cn_edge) {
+        const vertex_t& to_node = min_graph.vertice[cn_edge->to];
         if (history.has_vertice(to_node.id) || to_node.label < min_label)
           continue;
-        if (lexicographic_leq(cur_edge.label, cur_to.label, cn_edge.label, to_node.label)) {
-          dfs_code_t dfs_code{from_id, max_id + 1,
-            cur_node.label, cn_edge.label, to_node.label};
-          // A smaller code was found, so the given code is not minimal.
-          if (dfs_code_forward_compare_t{}(dfs_code, min_dfs_code)) {
-            return false;
-          }
-          if (dfs_code == min_dfs_code) {
-            min_projection.emplace_back(cn_edge, i);
-          }
+        dfs_code_t dfs_code{from_id, max_id + 1,
+          cur_node.label, cn_edge->label, to_node.label};
+        // A smaller code was found, so the given code is not minimal.
+        if (dfs_code_forward_compare_t{}(dfs_code, min_dfs_code)) {
+          return false;
         }
+        if (dfs_code != min_dfs_code)
+          break;
+        min_projection.emplace_back(*cn_edge, i);
       }
       // Every member of the RMP after this one will produce larger DFS codes,
       // so they don't need to be checked against the minimum.
@@ -243,7 +394,8 @@ bool gbolt_instance_t::is_forward_min(
   return true;
 }
 
-bool gbolt_instance_t::is_projection_min(const DfsCodes &dfs_codes) {
+template <typename W>
+bool basic_gbolt_instance_t<W>::is_projection_min(const DfsCodes &dfs_codes) {
   size_t projection_start_index = 0;
 
   // Start at index 1, index 0 has already been validated.
@@ -277,4 +429,15 @@ bool gbolt_instance_t::is_projection_min(const DfsCodes &dfs_codes) {
   return true;
 }
 
+#define GBOLT_INSTANTIATE(W) \
+  template int GBoltCore<W>::count_support(const Projection &) const; \
+  template void GBoltCore<W>::count_classes(const Projection &, int &, int &) const; \
+  template int GBoltCore<W>::count_mni(const Projection &, const DfsCodes &, \
+    const dfs_code_t &) const; \
+  template void basic_gbolt_instance_t<W>::build_min_graph(const DfsCodes &); \
+  template void basic_gbolt_instance_t<W>::update_right_most_path(const DfsCodes &, size_t); \
+  template bool basic_gbolt_instance_t<W>::is_min(const DfsCodes &);
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
 }  // namespace gbolt
@@ -0,0 +1,210 @@
+#include <gbolt.h>
+#include <common.h>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace gbolt {
+
+// Rounds of Weisfeiler-Lehman refinement: a vertex color covers the labels
+// within this distance
+static const int wl_rounds = 3;
+
+static inline uint64_t mix(uint64_t seed, uint64_t value) {
+  // splitmix64 finalizer of the combined value
+  uint64_t x = seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Vertex colors of graph after Weisfeiler-Lehman refinement. Isomorphic
+// graphs get the same colors on corresponding vertices.
+template <typename Graph>
+static std::vector<uint64_t> wl_colors(const Graph &graph) {
+  const size_t nvertice = graph.vertice.size();
+  std::vector<uint64_t> colors(nvertice);
+  for (size_t i = 0; i < nvertice; ++i) {
+    colors[i] = mix(graph.vertice[i].edges.size(), graph.vertice[i].label);
+  }
+  std::vector<uint64_t> next(nvertice);
+  std::vector<uint64_t> neighbors;
+  for (int round = 0; round < wl_rounds; ++round) {
+    for (size_t i = 0; i < nvertice; ++i) {
+      neighbors.clear();
+      for (const auto& edge : graph.vertice[i].edges) {
+        neighbors.push_back(mix(edge.label, colors[edge.to]));
+      }
+      std::sort(neighbors.begin(), neighbors.end());
+      uint64_t color = colors[i];
+      for (auto neighbor : neighbors) {
+        color = mix(color, neighbor);
+      }
+      next[i] = color;
+    }
+    colors.swap(next);
+  }
+  return colors;
+}
+
+// True iff graph has an edge labeled label between from and to
+template <typename Graph>
+static bool has_edge(const Graph &graph, int from, int to, int label) {
+  for (const auto& edge : graph.vertice[from].edges) {
+    if (edge.to == to && edge.label == label) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Exact isomorphism test of two graphs with the same sorted colors, by
+// backtracking over vertices of equal colors in breadth first order
+template <typename Graph>
+static bool isomorphic(const Graph &first, const std::vector<uint64_t> &first_colors,
+  const Graph &second, const std::vector<uint64_t> &second_colors) {
+  const int nvertice = first.vertice.size();
+  if (second.vertice.size() != first.vertice.size() || second.nedges != first.nedges) {
+    return false;
+  }
+  if (nvertice == 0) {
+    return true;
+  }
+
+  // Visiting the neighbors of mapped vertices first checks edges early
+  std::vector<int> order;
+  std::vector<bool> queued(nvertice, false);
+  for (int root = 0; root < nvertice; ++root) {
+    if (queued[root]) {
+      continue;
+    }
+    queued[root] = true;
+    order.push_back(root);
+    for (size_t i = order.size() - 1; i < order.size(); ++i) {
+      for (const auto& edge : first.vertice[order[i]].edges) {
+        if (!queued[edge.to]) {
+          queued[edge.to] = true;
+          order.push_back(edge.to);
+        }
+      }
+    }
+  }
+
+  // Candidates of a color are a contiguous range of second's vertices
+  std::vector<std::pair<uint64_t, int> > candidates;
+  for (int i = 0; i < nvertice; ++i) {
+    candidates.emplace_back(second_colors[i], i);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  std::vector<int> mapping(nvertice, -1);
+  std::vector<bool> used(nvertice, false);
+  // Position in the candidates of each level of the search
+  std::vector<size_t> positions(nvertice, 0);
+  int depth = 0;
+  positions[0] = std::lower_bound(candidates.begin(), candidates.end(),
+    std::make_pair(first_colors[order[0]], -1)) - candidates.begin();
+  while (depth >= 0) {
+    const int vertex = order[depth];
+    if (mapping[vertex] != -1) {
+      used[mapping[vertex]] = false;
+      mapping[vertex] = -1;
+    }
+    bool found = false;
+    size_t &position = positions[depth];
+    for (; position < candidates.size() &&
+      candidates[position].first == first_colors[vertex]; ++position) {
+      const int candidate = candidates[position].second;
+      if (used[candidate] ||
+        second.vertice[candidate].label != first.vertice[vertex].label) {
+        continue;
+      }
+      // Degrees are equal by their colors, so mapping every edge to a mapped
+      // vertex maps the edges one to one
+      bool consistent = true;
+      for (const auto& edge : first.vertice[vertex].edges) {
+        if (mapping[edge.to] != -1 &&
+          !has_edge(second, candidate, mapping[edge.to], edge.label)) {
+          consistent = false;
+          break;
+        }
+      }
+      if (consistent) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      --depth;
+      continue;
+    }
+    const int candidate = candidates[position++].second;
+    mapping[vertex] = candidate;
+    used[candidate] = true;
+    if (++depth == nvertice) {
+      return true;
+    }
+    positions[depth] = std::lower_bound(candidates.begin(), candidates.end(),
+      std::make_pair(first_colors[order[depth]], -1)) - candidates.begin();
+  }
+  return false;
+}
+
+template <typename W>
+void GBoltCore<W>::collapse_duplicates() {
+  const int ngraphs = graphs_.size();
+  std::vector<std::vector<uint64_t> > colors(ngraphs);
+  std::vector<uint64_t> hashes(ngraphs);
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel for schedule(dynamic, 64)
+  #endif
+  for (int i = 0; i < ngraphs; ++i) {
+    colors[i] = wl_colors(graphs_[i]);
+    std::vector<uint64_t> sorted_colors = colors[i];
+    std::sort(sorted_colors.begin(), sorted_colors.end());
+    uint64_t hash = mix(graphs_[i].vertice.size(), graphs_[i].nedges);
+    for (auto color : sorted_colors) {
+      hash = mix(hash, color);
+    }
+    hashes[i] = hash;
+  }
+
+  // The first graph of every isomorphism class represents the others
+  std::unordered_map<uint64_t, std::vector<int> > representatives;
+  graph_weights_.assign(ngraphs, 1);
+  duplicate_graphs_.assign(ngraphs, std::vector<int>());
+  int nduplicates = 0;
+  for (int i = 0; i < ngraphs; ++i) {
+    std::vector<int> &same_hash = representatives[hashes[i]];
+    int representative = -1;
+    for (auto graph_id : same_hash) {
+      if (isomorphic(graphs_[graph_id], colors[graph_id], graphs_[i], colors[i])) {
+        representative = graph_id;
+        break;
+      }
+    }
+    if (representative == -1) {
+      same_hash.push_back(i);
+      continue;
+    }
+    // Duplicates are no longer projected
+    ++graph_weights_[representative];
+    graph_weights_[i] = 0;
+    duplicate_graphs_[representative].push_back(i);
+    const int id = graphs_[i].id;
+    graphs_[i] = Graph();
+    graphs_[i].id = id;
+    std::vector<uint64_t>().swap(colors[i]);
+    ++nduplicates;
+  }
+
+  LOG_INFO("gbolt collapsed %d duplicate graphs into %d unique graphs",
+    nduplicates, ngraphs - nduplicates);
+}
+
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::collapse_duplicates();
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
+}  // namespace gbolt
@@ -2,6 +2,10 @@
 #include <database.h>
 #include <common.h>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <utility>
 
 namespace gbolt {
 
@@ -14,7 +18,11 @@ void GBolt::read_input(const std::string &input_file, const std::string &separat
   CPU_TIMER_START(elapsed, time_start);
   #endif
 
-  db.read_input(input_file, separator);
+  {
+    PerfScope scope(counters(), PHASE_READ);
+    db.read_input(input_file, separator);
+  }
+  PerfScope scope(counters(), PHASE_CONSTRUCT);
 
   #ifdef GBOLT_PERFORMANCE
   CPU_TIMER_END(elapsed, time_start, time_end);
@@ -22,12 +30,73 @@ void GBolt::read_input(const std::string &input_file, const std::string &separat
   CPU_TIMER_START(elapsed, time_start);
   #endif
 
-  nsupport_ = db.get_graphs().size() * support_;
+  if (mni_support_ > 0) {
+    nsupport_ = mni_support_;
+  } else if (!query_file_.empty()) {
+    // Queries may hold any label of the input
+    nsupport_ = 1;
+  } else if (classes()) {
+    ntarget_graphs_ = 0;
+    for (const auto& graph : db.get_graphs()) {
+      if (graph.graph_class < 0) {
+        LOG_ERROR("Graph %d has a negative class %d", graph.id, graph.graph_class);
+      }
+      graph_classes_.push_back(graph.graph_class);
+      ntarget_graphs_ += graph.graph_class == target_class_;
+    }
+    nother_graphs_ = graph_classes_.size() - ntarget_graphs_;
+    if (ntarget_graphs_ == 0) {
+      LOG_ERROR("No graph of the target class %d", target_class_);
+    }
+    // A reported pattern reaches both the support and the score in the target
+    // class, and so do its labels
+    target_nsupport_ = std::max(static_cast<int>(ntarget_graphs_ * support_),
+      static_cast<int>(std::ceil(ntarget_graphs_ * min_score_ - 1e-9)));
+    nsupport_ = target_nsupport_;
+  } else if (incremental()) {
+    if (!state_in_.empty()) {
+      state_.read(state_in_);
+      if (static_cast<size_t>(state_.ngraphs) > db.get_graphs().size()) {
+        LOG_ERROR("State has %d graphs, more than the input", state_.ngraphs);
+      }
+    }
+    if (border_ == 0.0) {
+      border_ = state_in_.empty() ? support_ : state_.border;
+    }
+    if (border_ > support_) {
+      LOG_ERROR("Border %f of the state is greater than the support", border_);
+    }
+    // Keep labels down to the border, to find every pattern of the new state
+    nsupport_ = db.get_graphs().size() * border_;
+  } else {
+    nsupport_ = db.get_graphs().size() * support_;
+  }
 
-  find_frequent_nodes_and_edges(db);
+  std::unordered_map<int, int> vertex_label_ids;
+  std::unordered_map<int, int> edge_label_ids;
+  find_frequent_nodes_and_edges(db, vertex_label_ids, edge_label_ids);
 
-  // Prune the initial graph by frequent labels
-  db.construct_graphs(frequent_vertex_labels_, frequent_edge_labels_, graphs_);
+  // Mine with the narrow width if the dense labels and the vertex ids of every
+  // graph fit it, the graphs and DFS codes of the wide one are larger
+  const size_t max_labels =
+    static_cast<size_t>(std::numeric_limits<narrow_width_t::label_t>::max()) + 1;
+  const size_t max_vertice =
+    static_cast<size_t>(std::numeric_limits<narrow_width_t::vid_t>::max()) + 1;
+  bool narrow = frequent_vertex_labels_.size() <= max_labels &&
+    frequent_edge_labels_.size() <= max_labels;
+  for (const auto& graph : db.get_graphs()) {
+    narrow = narrow && graph.vertices.size() <= max_vertice;
+  }
+  LOG_INFO("gbolt mines %zu vertex and %zu edge labels with %s",
+    frequent_vertex_labels_.size(), frequent_edge_labels_.size(),
+    narrow ? "8 bit labels and 16 bit vertex ids" : "32 bit labels and vertex ids");
+  if (narrow) {
+    narrow_.reset(new GBoltCore<narrow_width_t>(std::move(*this)));
+    narrow_->construct(db, vertex_label_ids, edge_label_ids);
+  } else {
+    wide_.reset(new GBoltCore<wide_width_t>(std::move(*this)));
+    wide_->construct(db, vertex_label_ids, edge_label_ids);
+  }
 
   #ifdef GBOLT_PERFORMANCE
   CPU_TIMER_END(elapsed, time_start, time_end);
@@ -36,15 +105,98 @@ void GBolt::read_input(const std::string &input_file, const std::string &separat
 }
 
 void GBolt::execute() {
+  if (narrow_) {
+    narrow_->execute();
+  } else {
+    wide_->execute();
+  }
+}
+
+void GBolt::save(bool output_parent, bool output_pattern, bool output_frequent_nodes) {
+  if (narrow_) {
+    narrow_->save(output_parent, output_pattern, output_frequent_nodes);
+  } else {
+    wide_->save(output_parent, output_pattern, output_frequent_nodes);
+  }
+}
+
+void GBolt::save_trace(const std::string &trace_file) const {
+  if (narrow_) {
+    narrow_->save_trace(trace_file);
+  } else {
+    wide_->save_trace(trace_file);
+  }
+}
+
+void GBolt::report_counters() const {
+  if (narrow_) {
+    narrow_->report_counters();
+  } else {
+    wide_->report_counters();
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::construct(Database &db,
+  const std::unordered_map<int, int> &vertex_label_ids,
+  const std::unordered_map<int, int> &edge_label_ids) {
+  // Prune the initial graph by frequent labels and label triples. Minimum
+  // image based support does not count triples by graphs.
+  db.construct_graphs<W>(vertex_label_ids, edge_label_ids,
+    mni_support_ > 0 ? 0 : nsupport_, graphs_);
+
+  if (collapse_duplicates_) {
+    collapse_duplicates();
+  }
+
+  // Minimum image based support numbers the vertices of all graphs globally
+  if (mni_support_ > 0) {
+    vertex_offsets_.push_back(0);
+    for (const auto& graph : graphs_) {
+      vertex_offsets_.push_back(vertex_offsets_.back() + graph.vertice.size());
+    }
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::execute() {
   #ifdef GBOLT_PERFORMANCE
   struct timeval time_start, time_end;
   double elapsed = 0.0;
   CPU_TIMER_START(elapsed, time_start);
   #endif
 
+  // The monitor only reads the counters of the mining threads
+  std::unique_ptr<Monitor> monitor;
+  if (progress_interval_ > 0.0) {
+    #ifdef GBOLT_SERIAL
+    const int num_threads = 1;
+    #else
+    const int num_threads = omp_get_max_threads();
+    #endif
+    progress_.reset(new progress_counter_t[num_threads]);
+    monitor.reset(new Monitor(progress_.get(), num_threads, progress_interval_, progress_file_));
+    monitor->start();
+  }
+
   // Graph mining
-  init_instances();
-  project();
+  if (incremental()) {
+    execute_incremental();
+  } else if (!query_file_.empty()) {
+    execute_query();
+  } else if (sample_ > 0.0) {
+    execute_sample();
+  } else if (gaston_) {
+    init_instances();
+    gaston_project();
+  } else {
+    init_instances();
+    project();
+  }
+
+  if (monitor) {
+    monitor->stop();
+  }
 
   #ifdef GBOLT_PERFORMANCE
   CPU_TIMER_END(elapsed, time_start, time_end);
@@ -52,7 +204,8 @@ void GBolt::execute() {
   #endif
 }
 
-void GBolt::init_instances() {
+template <typename W>
+void GBoltCore<W>::init_instances() {
   #ifdef GBOLT_SERIAL
   int num_threads = 1;
   #else
@@ -75,32 +228,122 @@ void GBolt::init_instances() {
     LOG_INFO("gbolt create thread %d", i);
     #endif
     std::string output_file_thread = output_file_ + ".t" + std::to_string(i);
-    gbolt_instances_.emplace_back(max_edges, max_vertice, output_file_thread);
+    gbolt_instances_.emplace_back(max_edges, max_vertice, output_file_thread,
+      frequent_vertex_labels_, frequent_edge_labels_);
+    if (merge_output_) {
+      gbolt_instances_.back().output.keep_keys();
+    }
+    if (!graph_weights_.empty()) {
+      gbolt_instances_.back().duplicate_graphs = &duplicate_graphs_;
+    }
+    if (counters_) {
+      gbolt_instances_.back().counters = &counters_[i];
+    }
+    if (progress_) {
+      gbolt_instances_.back().progress = &progress_[i];
+    }
+    if (classes()) {
+      gbolt_instances_.back().graph_classes = &graph_classes_;
+      gbolt_instances_.back().nclasses =
+        *std::max_element(graph_classes_.begin(), graph_classes_.end()) + 1;
+    }
   }
 }
 
-void GBolt::project() {
-  ProjectionMap projection_map;
+// Edges of a graph projected by each parallel task
+static const size_t project_chunk_size = 1 << 16;
+
+// Projects the first edges leaving vertices [first, last) of graph
+template <typename Graph, typename Map>
+static void project_vertice(const Graph &graph, size_t first, size_t last, Map &projection_map) {
+  for (size_t i = first; i < last; ++i) {
+    const auto& vertex = graph.vertice[i];
 
+    for (const auto& edge : vertex.edges) {
+      // Partial pruning: if the first label is greater than the
+      // second label, then there must be another graph whose second
+      // label is greater than the first label.
+      const int vertex_to_label = graph.vertice[edge.to].label;
+      if (vertex.label <= vertex_to_label) {
+        // Push dfs code according to the same edge label
+        typename Map::key_type dfs_code{0, 1, vertex.label, edge.label, vertex_to_label};
+        // Push all the graphs
+        projection_map[dfs_code].emplace_back(graph.id, graph.edge_index(edge), Projection::npos);
+      }
+    }
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::project(ProjectionMap &projection_map) const {
+  PerfScope scope(counters(), PHASE_PROJECT);
   // Construct the first edge
-  for (const auto& graph : graphs_) {
+  for (auto it = graphs_.begin() + first_graph_; it != graphs_.end(); ++it) {
+    const Graph &graph = *it;
+    if (!sampled_.empty() && !sampled_[graph.id]) {
+      continue;
+    }
+    if (graph.edges.size() <= project_chunk_size) {
+      project_vertice(graph, 0, graph.vertice.size(), projection_map);
+      continue;
+    }
+
+    // A single large graph is projected by chunks of its vertices, merged in
+    // vertex order
+    const size_t nvertice = graph.vertice.size();
+    const size_t nchunks = (graph.edges.size() + project_chunk_size - 1) / project_chunk_size;
+    std::vector<ProjectionMap> chunk_maps(nchunks);
+    #ifndef GBOLT_SERIAL
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+      project_vertice(graph, nvertice * chunk / nchunks, nvertice * (chunk + 1) / nchunks,
+        chunk_maps[chunk]);
+    }
+    for (auto& chunk_map : chunk_maps) {
+      for (const auto& kv_pair : chunk_map) {
+        projection_map[kv_pair.first].append(kv_pair.second);
+      }
+    }
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::project(GraphIdsMap &graph_ids_map) const {
+  PerfScope scope(counters(), PHASE_PROJECT);
+  for (auto it = graphs_.begin() + first_graph_; it != graphs_.end(); ++it) {
+    const Graph &graph = *it;
+    if (!sampled_.empty() && !sampled_[graph.id]) {
+      continue;
+    }
 
     for (const auto& vertex : graph.vertice) {
 
       for (const auto& edge : vertex.edges) {
-        // Partial pruning: if the first label is greater than the
-        // second label, then there must be another graph whose second
-        // label is greater than the first label.
         const int vertex_to_label = graph.vertice[edge.to].label;
         if (vertex.label <= vertex_to_label) {
-          // Push dfs code according to the same edge label
           dfs_code_t dfs_code{0, 1, vertex.label, edge.label, vertex_to_label};
-          // Push all the graphs
-          projection_map[dfs_code].emplace_back(graph.id, edge, nullptr);
+          // Graphs are visited in order, so only the last id can repeat
+          auto& graph_ids = graph_ids_map[dfs_code];
+          if (graph_ids.empty() || graph_ids.back() != graph.id) {
+            graph_ids.push_back(graph.id);
+          }
         }
       }
     }
   }
+}
+
+template <typename W>
+void GBoltCore<W>::project() {
+  ProjectionMap projection_map;
+  GraphIdsMap graph_ids_map;
+  if (embedding_free_) {
+    project(graph_ids_map);
+  } else {
+    project(projection_map);
+  }
+
   // Mine subgraphs
   int prev_graph_id = -1;
   int prev_thread_id = thread_id();
@@ -114,10 +357,23 @@ void GBolt::project() {
     for (const auto& kv_pair : projection_map) {
       mine_child(kv_pair.second, kv_pair.first, dfs_codes, prev_thread_id, prev_graph_id);
     }
+    for (const auto& kv_pair : graph_ids_map) {
+      mine_child(kv_pair.second, kv_pair.first, dfs_codes, prev_thread_id, prev_graph_id);
+    }
   }
   #ifndef GBOLT_SERIAL
   #pragma omp taskwait
   #endif
 }
 
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::construct(Database &, const std::unordered_map<int, int> &, \
+    const std::unordered_map<int, int> &); \
+  template void GBoltCore<W>::execute(); \
+  template void GBoltCore<W>::init_instances(); \
+  template void GBoltCore<W>::project(ProjectionMap &) const; \
+  template void GBoltCore<W>::project();
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
 }  // namespace gbolt
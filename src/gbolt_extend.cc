@@ -1,37 +1,316 @@
 #include <gbolt.h>
 #include <history.h>
 #include <common.h>
+#include <algorithm>
+#include <utility>
 
 namespace gbolt {
 
-void GBolt::enumerate(
+// Embeddings enumerated by each parallel task of a large projection
+static const uint32_t enumerate_chunk_size = 1 << 14;
+
+// Moves the extensions of a chunk into map, after those of earlier chunks
+template <typename Map>
+static void merge_chunk(Map &chunk_map, Map &map) {
+  for (auto& kv_pair : chunk_map) {
+    auto it = map.find(kv_pair.first);
+    if (it == map.end()) {
+      map.emplace(kv_pair.first, std::move(kv_pair.second));
+    } else {
+      it->second.append(kv_pair.second);
+    }
+  }
+  chunk_map.clear();
+}
+
+template <typename W>
+template <typename MapBackward, typename MapForward>
+void GBoltCore<W>::enumerate(
   const DfsCodes &dfs_codes,
   const Projection &projection,
   const std::vector<int> &right_most_path,
-  ProjectionMapBackward &projection_map_backward,
-  ProjectionMapForward &projection_map_forward) {
+  MapBackward &projection_map_backward,
+  MapForward &projection_map_forward) {
+  if (projection.size() <= enumerate_chunk_size) {
+    enumerate_embeddings(dfs_codes, projection, right_most_path, 0, projection.size(),
+      projection_map_backward, projection_map_forward);
+  } else {
+    // Chunks hold whole runs, unless a run is larger than a chunk, as the
+    // embeddings of a single large graph are. Such runs are split into chunks
+    // of their own.
+    const auto& runs = projection.runs();
+    std::vector<uint32_t> bounds{0};
+    for (size_t run = 0; run < runs.size(); ++run) {
+      const uint32_t begin = runs[run].begin;
+      const uint32_t end = projection.run_end(run);
+      if (end - begin > enumerate_chunk_size) {
+        if (bounds.back() != begin) {
+          bounds.push_back(begin);
+        }
+        for (uint32_t bound = begin + enumerate_chunk_size; bound < end;
+          bound += enumerate_chunk_size) {
+          bounds.push_back(bound);
+        }
+        bounds.push_back(end);
+      } else if (end - bounds.back() >= enumerate_chunk_size) {
+        bounds.push_back(end);
+      }
+    }
+    if (bounds.back() != projection.size()) {
+      bounds.push_back(projection.size());
+    }
+    const size_t nchunks = bounds.size() - 1;
+    std::vector<MapBackward> chunk_maps_backward(nchunks);
+    std::vector<MapForward> chunk_maps_forward(nchunks);
+    // Other tasks run on this thread while waiting, and their is_min may
+    // overwrite the rightmost path of the instance
+    const std::vector<int> path = right_most_path;
+    #ifndef GBOLT_SERIAL
+    #pragma omp taskgroup
+    #endif
+    {
+      for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+        #ifndef GBOLT_SERIAL
+        #pragma omp task shared(dfs_codes, projection, path, bounds, chunk_maps_backward, chunk_maps_forward) firstprivate(chunk)
+        #endif
+        enumerate_embeddings(dfs_codes, projection, path, bounds[chunk], bounds[chunk + 1],
+          chunk_maps_backward[chunk], chunk_maps_forward[chunk]);
+      }
+    }
+    // Chunks are merged in embedding order, keeping the runs of every child
+    // sorted. A graph split between chunks continues its run.
+    for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+      merge_chunk(chunk_maps_backward[chunk], projection_map_backward);
+      merge_chunk(chunk_maps_forward[chunk], projection_map_forward);
+    }
+  }
+
+  // Children index into this projection
+  for (auto& kv_pair : projection_map_backward) {
+    kv_pair.second.set_parent(&projection);
+  }
+  for (auto& kv_pair : projection_map_forward) {
+    kv_pair.second.set_parent(&projection);
+  }
+}
+
+template <typename W>
+template <typename MapBackward, typename MapForward>
+void GBoltCore<W>::enumerate_embeddings(
+  const DfsCodes &dfs_codes,
+  const Projection &projection,
+  const std::vector<int> &right_most_path,
+  uint32_t first,
+  uint32_t last,
+  MapBackward &projection_map_backward,
+  MapForward &projection_map_forward) {
+  PerfScope scope(counters(), PHASE_ENUMERATE);
   History& history = thread_instance().history;
-  for (const auto& link : projection) {
-    const Graph &graph = graphs_[link.id];
-    history.build(link, graph);
-
-    get_backward(link, history, graph, dfs_codes, right_most_path,
-      projection_map_backward);
-    get_first_forward(link, history, graph, dfs_codes, right_most_path,
-      projection_map_forward);
-    get_other_forward(link, history, graph, dfs_codes, right_most_path,
-      projection_map_forward);
+  const auto& runs = projection.runs();
+  // The run holding the first embedding
+  size_t run = std::upper_bound(runs.begin(), runs.end(), first,
+    [](uint32_t index, const projection_run_t &run) {
+      return index < run.begin;
+    }) - runs.begin() - 1;
+  for (uint32_t i = first; i < last; ++run) {
+    const Graph &graph = graphs_[runs[run].id];
+    const uint32_t run_end = std::min(projection.run_end(run), last);
+
+    for (; i < run_end; ++i) {
+      history.build(projection, i, graph);
+
+      get_backward(i, history, graph, dfs_codes, right_most_path,
+        projection_map_backward);
+      get_first_forward(i, history, graph, dfs_codes, right_most_path,
+        projection_map_forward);
+      get_other_forward(i, history, graph, dfs_codes, right_most_path,
+        projection_map_forward);
+    }
   }
   history.clear();
 }
 
-void GBolt::get_backward(
-  const prev_dfs_t &prev_dfs,
+template <typename W>
+void GBoltCore<W>::materialize(
+  const DfsCodes &dfs_codes,
+  const Projection &projection,
+  const std::vector<int> &right_most_path,
+  const std::vector<int> &graph_ids,
+  Projection &child) {
+  PerfScope scope(counters(), PHASE_ENUMERATE);
+  const dfs_code_t &code = *dfs_codes.back();
+  const bool backward = code.from > code.to;
+  // The code fixes the vertex it extends from and the pattern vertex a
+  // backward edge goes to: either the rightmost vertex or the from vertex of
+  // an edge in the rightmost path
+  const int extended_id = backward ? code.to : code.from;
+  const bool right_most = extended_id == dfs_codes[right_most_path[0]]->to;
+  size_t position = 0;
+  if (!right_most) {
+    while (dfs_codes[right_most_path[position]]->from != extended_id) {
+      ++position;
+    }
+  }
+
+  const int parent_size = dfs_codes.size() - 1;
+  History& history = thread_instance().history;
+  const auto& runs = projection.runs();
+  size_t run = 0;
+  for (auto graph_id : graph_ids) {
+    // Both are in graph order
+    while (runs[run].id != graph_id) {
+      ++run;
+    }
+    const Graph &graph = graphs_[graph_id];
+    const uint32_t run_end = projection.run_end(run);
+
+    for (uint32_t i = runs[run].begin; i < run_end; ++i) {
+      // Walk up the embedding to the rightmost path edges first, and build
+      // the history only for embeddings having edges with the code's labels
+      const Projection *level = &projection;
+      uint32_t index = i;
+      const edge_t *right_most_edge = nullptr;
+      for (int k = parent_size - 1; ; --k) {
+        const prev_dfs_t &prev_dfs = (*level)[index];
+        if (k == right_most_path[0]) {
+          right_most_edge = &graph.edges[prev_dfs.edge];
+        }
+        if (k == right_most_path[position]) {
+          break;
+        }
+        index = prev_dfs.prev;
+        level = level->parent();
+      }
+      const edge_t &path_edge = graph.edges[(*level)[index].edge];
+      const int extended = right_most ? path_edge.to : path_edge.from;
+      const int from = backward ? right_most_edge->to : extended;
+
+      // Edges are sorted by (edge label, to label), and the partial pruning of
+      // the enumeration rules only depends on labels, which the code fixes
+      const vertex_t& from_node = graph.vertice[from];
+      const edge_t *edge = graph.lower_bound(from_node.edges.begin(),
+        from_node.edges.end(), code.edge_label, code.to_label);
+      const edge_t *end = edge;
+      while (end != from_node.edges.end() && end->label == code.edge_label &&
+        graph.vertice[end->to].label == code.to_label) {
+        ++end;
+      }
+      if (edge == end) {
+        continue;
+      }
+      history.build(projection, i, graph);
+      for (; edge != end; ++edge) {
+        if (backward ? edge->to == extended && !history.has_edges(edge->id) :
+          !history.has_vertice(edge->to)) {
+          child.emplace_back(graph_id, graph.edge_index(*edge), i);
+        }
+      }
+    }
+  }
+  history.clear();
+  child.set_parent(&projection);
+}
+
+template <typename W>
+bool GBoltCore<W>::embed(
+  const DfsCodes &dfs_codes,
+  const Graph &graph,
+  std::vector<Projection> &levels) {
+  PerfScope scope(counters(), PHASE_ENUMERATE);
+  History& history = thread_instance().history;
+
+  // The first code matches edges leaving any vertex, as in project
+  const dfs_code_t &first_code = *(dfs_codes[0]);
+  levels[0].clear();
+  for (const auto& vertex : graph.vertice) {
+    if (vertex.label != first_code.from_label)
+      continue;
+    const edge_t *edge = graph.lower_bound(vertex.edges.begin(), vertex.edges.end(),
+      first_code.edge_label, first_code.to_label);
+    const edge_t *edge_end = graph.lower_bound(edge, vertex.edges.end(),
+      first_code.edge_label, first_code.to_label + 1);
+    for (; edge != edge_end; ++edge) {
+      levels[0].emplace_back(graph.id, graph.edge_index(*edge), Projection::npos);
+    }
+  }
+
+  // Graph vertex of each pattern vertex in the current instance
+  std::vector<int> vertex_map(dfs_codes.size() + 1);
+  for (size_t i = 1; i < dfs_codes.size(); ++i) {
+    const dfs_code_t &code = *(dfs_codes[i]);
+    const Projection &projection = levels[i - 1];
+    levels[i].clear();
+    levels[i].set_parent(&projection);
+
+    for (uint32_t j = 0; j < projection.size(); ++j) {
+      history.build(projection, j, graph);
+      for (size_t k = 0; k < i; ++k) {
+        const edge_t &edge = history.get_edge(k);
+        vertex_map[dfs_codes[k]->from] = edge.from;
+        vertex_map[dfs_codes[k]->to] = edge.to;
+      }
+
+      // Only the edges with the labels of the code can match it
+      const vertex_t &from_node = graph.vertice[vertex_map[code.from]];
+      const edge_t *edge = graph.lower_bound(from_node.edges.begin(), from_node.edges.end(),
+        code.edge_label, code.to_label);
+      const edge_t *edge_end = graph.lower_bound(edge, from_node.edges.end(),
+        code.edge_label, code.to_label + 1);
+      for (; edge != edge_end; ++edge) {
+        if (code.from > code.to) {
+          // Backward code, the edge must close the cycle
+          if (edge->to != vertex_map[code.to] || history.has_edges(edge->id))
+            continue;
+        } else {
+          // Forward code, the edge must discover a new vertex
+          if (history.has_vertice(edge->to))
+            continue;
+        }
+        levels[i].emplace_back(graph.id, graph.edge_index(*edge), j);
+      }
+    }
+    history.clear();
+  }
+  return levels.back().size() != 0;
+}
+
+template <typename W>
+void GBoltCore<W>::embed(
+  const DfsCodes &dfs_codes,
+  const std::vector<int> &graph_ids,
+  std::vector<Projection> &levels) {
+  levels.assign(dfs_codes.size(), Projection());
+  for (size_t i = 1; i < levels.size(); ++i) {
+    levels[i].set_parent(&levels[i - 1]);
+  }
+  // Each graph is embedded on its own, then appended with its parent indices
+  // moved past the instances of the graphs before it
+  std::vector<Projection> graph_levels(dfs_codes.size());
+  std::vector<uint32_t> offsets(dfs_codes.size());
+  for (auto graph_id : graph_ids) {
+    if (!embed(dfs_codes, graphs_[graph_id], graph_levels)) {
+      continue;
+    }
+    for (size_t i = 0; i < levels.size(); ++i) {
+      offsets[i] = levels[i].size();
+      const Projection &graph_level = graph_levels[i];
+      for (uint32_t j = 0; j < graph_level.size(); ++j) {
+        levels[i].emplace_back(graph_id, graph_level[j].edge,
+          i == 0 ? Projection::npos : graph_level[j].prev + offsets[i - 1]);
+      }
+    }
+  }
+}
+
+template <typename W>
+template <typename Map>
+void GBoltCore<W>::get_backward(
+  uint32_t prev,
   const History &history,
   const Graph &graph,
   const DfsCodes &dfs_codes,
   const std::vector<int> &right_most_path,
-  ProjectionMapBackward &projection_map_backward) {
+  Map &projection_map_backward) {
   const edge_t& last_edge = history.get_edge(right_most_path[0]);
   const vertex_t& last_node = graph.vertice[last_edge.to];
 
@@ -51,7 +330,7 @@ void GBolt::get_backward(
         dfs_code_t dfs_code{from_id, to_id,
           last_node.label, ln_edge.label, from_node_label};
         projection_map_backward[dfs_code].
-          emplace_back(graph.id, ln_edge, &prev_dfs);
+          emplace_back(graph.id, graph.edge_index(ln_edge), prev);
       }
 
       break;
@@ -59,41 +338,67 @@ void GBolt::get_backward(
   }
 }
 
-void GBolt::get_first_forward(
-  const prev_dfs_t &prev_dfs,
+template <typename W>
+template <typename Map>
+void GBoltCore<W>::get_first_forward(
+  uint32_t prev,
   const History &history,
   const Graph &graph,
   const DfsCodes &dfs_codes,
   const std::vector<int> &right_most_path,
-  ProjectionMapForward &projection_map_forward) {
+  Map &projection_map_forward) {
   const edge_t& last_edge = history.get_edge(right_most_path[0]);
   const vertex_t& last_node = graph.vertice[last_edge.to];
   const int min_label = dfs_codes[0]->from_label;
 
   const int to_id = dfs_codes[right_most_path[0]]->to;
-  for (const auto& ln_edge : last_node.edges) {
-    const int to_node_label = graph.vertice[ln_edge.to].label;
-    // Partial pruning: if this label is less than the minimum label, then there
-    // should exist another lexicographical order which renders the same letters, but
-    // in the asecending order.
-    // Could we perform the same partial pruning as other extending methods?
-    // No, we cannot, for this time, the extending id is greater the the last node
-    if (history.has_vertice(ln_edge.to) || to_node_label < min_label)
-      continue;
-    dfs_code_t dfs_code{to_id, to_id + 1,
-      last_node.label, ln_edge.label, to_node_label};
-    projection_map_forward[dfs_code].
-      emplace_back(graph.id, ln_edge, &prev_dfs);
+  // Partial pruning: if this label is less than the minimum label, then there
+  // should exist another lexicographical order which renders the same letters, but
+  // in the asecending order.
+  // Could we perform the same partial pruning as other extending methods?
+  // No, we cannot, for this time, the extending id is greater the the last node
+  if (last_node.edges.size() <= Graph::linear_scan_edges) {
+    // A few edges are cheaper to filter than to skip through
+    for (const auto& ln_edge : last_node.edges) {
+      if (history.has_vertice(ln_edge.to))
+        continue;
+      const int to_node_label = graph.vertice[ln_edge.to].label;
+      if (to_node_label < min_label)
+        continue;
+      dfs_code_t dfs_code{to_id, to_id + 1,
+        last_node.label, ln_edge.label, to_node_label};
+      projection_map_forward[dfs_code].
+        emplace_back(graph.id, graph.edge_index(ln_edge), prev);
+    }
+    return;
+  }
+  const edge_t *ln_edge = last_node.edges.begin();
+  const edge_t *ln_end = last_node.edges.end();
+  while (ln_edge != ln_end) {
+    // Edges are sorted by (edge label, to label), so skip to the first edge
+    // of this edge label whose to label is not less than the minimum label
+    const int edge_label = ln_edge->label;
+    ln_edge = graph.lower_bound(ln_edge, ln_end, edge_label, min_label);
+    for (; ln_edge != ln_end && ln_edge->label == edge_label; ++ln_edge) {
+      if (history.has_vertice(ln_edge->to))
+        continue;
+      dfs_code_t dfs_code{to_id, to_id + 1,
+        last_node.label, edge_label, graph.vertice[ln_edge->to].label};
+      projection_map_forward[dfs_code].
+        emplace_back(graph.id, graph.edge_index(*ln_edge), prev);
+    }
   }
 }
 
-void GBolt::get_other_forward(
-  const prev_dfs_t &prev_dfs,
+template <typename W>
+template <typename Map>
+void GBoltCore<W>::get_other_forward(
+  uint32_t prev,
   const History &history,
   const Graph &graph,
   const DfsCodes &dfs_codes,
   const std::vector<int> &right_most_path,
-  ProjectionMapForward &projection_map_forward) {
+  Map &projection_map_forward) {
   const int min_label = dfs_codes[0]->from_label;
 
   const int to_id = dfs_codes[right_most_path[0]]->to;
@@ -103,20 +408,59 @@ void GBolt::get_other_forward(
     const vertex_t& cur_to = graph.vertice[cur_edge.to];
     const int from_id = dfs_codes[i]->from;
 
-    for (const auto& cn_edge : cur_node.edges) {
-      const vertex_t& to_node = graph.vertice[cn_edge.to];
+    if (cur_node.edges.size() <= Graph::linear_scan_edges) {
+      for (const auto& cn_edge : cur_node.edges) {
+        if (history.has_vertice(cn_edge.to))
+          continue;
+        // Partial pruning: guarantees that extending label is greater
+        // than the minimum one
+        const int to_node_label = graph.vertice[cn_edge.to].label;
+        if (to_node_label < min_label ||
+          !lexicographic_leq(cur_edge.label, cur_to.label, cn_edge.label, to_node_label))
+          continue;
+        dfs_code_t dfs_code{from_id, to_id + 1, cur_node.label,
+          cn_edge.label, to_node_label};
+        projection_map_forward[dfs_code].
+          emplace_back(graph.id, graph.edge_index(cn_edge), prev);
+      }
+      continue;
+    }
+    // Edges are sorted by (edge label, to label), so every edge from the lower
+    // bound of the current edge on is lexicographically greater or equal. The
+    // to label of the current edge is never less than the minimum label.
+    const edge_t *cn_edge = graph.lower_bound(cur_node.edges.begin(),
+      cur_node.edges.end(), cur_edge.label, cur_to.label);
+    const edge_t *cn_end = cur_node.edges.end();
+    while (cn_edge != cn_end) {
       // Partial pruning: guarantees that extending label is greater
       // than the minimum one
-      if (history.has_vertice(to_node.id) || to_node.label < min_label)
-        continue;
-      if (lexicographic_leq(cur_edge.label, cur_to.label, cn_edge.label, to_node.label)) {
+      const int edge_label = cn_edge->label;
+      cn_edge = graph.lower_bound(cn_edge, cn_end, edge_label,
+        edge_label == cur_edge.label ? cur_to.label : min_label);
+      for (; cn_edge != cn_end && cn_edge->label == edge_label; ++cn_edge) {
+        if (history.has_vertice(cn_edge->to))
+          continue;
         dfs_code_t dfs_code{from_id, to_id + 1, cur_node.label,
-          cn_edge.label, to_node.label};
+          edge_label, graph.vertice[cn_edge->to].label};
         projection_map_forward[dfs_code].
-          emplace_back(graph.id, cn_edge, &prev_dfs);
+          emplace_back(graph.id, graph.edge_index(*cn_edge), prev);
       }
     }
   }
 }
 
+// Projections for the mining kernels, supporting graphs for counting first
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::enumerate(const DfsCodes &, const Projection &, \
+    const std::vector<int> &, ProjectionMapBackward &, ProjectionMapForward &); \
+  template void GBoltCore<W>::enumerate(const DfsCodes &, const Projection &, \
+    const std::vector<int> &, ChildGraphsMapBackward &, ChildGraphsMapForward &); \
+  template void GBoltCore<W>::materialize(const DfsCodes &, const Projection &, \
+    const std::vector<int> &, const std::vector<int> &, Projection &); \
+  template bool GBoltCore<W>::embed(const DfsCodes &, const Graph &, std::vector<Projection> &); \
+  template void GBoltCore<W>::embed(const DfsCodes &, const std::vector<int> &, \
+    std::vector<Projection> &);
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
 }  // namespace gbolt
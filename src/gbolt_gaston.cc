@@ -0,0 +1,432 @@
+#include <gbolt.h>
+#include <gaston.h>
+#include <common.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_set>
+
+namespace gbolt {
+
+// Embeddings are ordered by graph, so only the last id can repeat
+static int gaston_support(const gaston_projection_t &projection) {
+  int nsupport = 0;
+  int prev_id = -1;
+  for (auto graph_id : projection.graph_ids) {
+    if (graph_id != prev_id) {
+      ++nsupport;
+      prev_id = graph_id;
+    }
+  }
+  return nsupport;
+}
+
+template <typename W>
+void basic_gbolt_instance_t<W>::report(const GastonPattern &pattern,
+  const gaston_projection_t &projection, int nsupport,
+  int prev_thread_id, int prev_graph_id) {
+  PerfScope scope(counters, PHASE_REPORT);
+  if (progress != nullptr) {
+    progress_add(progress->patterns);
+  }
+  if (output.keeps_keys()) {
+    // Merged output is keyed and numbered by the minimum DFS code, as in gSpan,
+    // so it does not depend on the order patterns were found in
+    const std::vector<wide_dfs_code_t> min_codes = pattern.min_dfs_codes();
+    const std::vector<dfs_code_t> codes(min_codes.begin(), min_codes.end());
+    DfsCodes dfs_codes;
+    for (const auto& code : codes) {
+      dfs_codes.push_back(&code);
+    }
+    std::vector<int> graph_ids;
+    for (auto graph_id : projection.graph_ids) {
+      if (graph_ids.empty() || graph_ids.back() != graph_id) {
+        graph_ids.push_back(graph_id);
+      }
+    }
+    build_min_graph(dfs_codes);
+    report(dfs_codes, graph_ids, nsupport, prev_thread_id, prev_graph_id);
+    return;
+  }
+
+  std::stringstream ss;
+
+  for (size_t i = 0; i < pattern.labels.size(); ++i) {
+    ss << "v " << i << ' ' << vertex_labels[pattern.labels[i]] << '\n';
+  }
+  for (const auto& edge : pattern.edges) {
+    ss << "e " << edge.from << ' ' << edge.to
+      << ' ' << edge_labels[edge.label] << '\n';
+  }
+  ss << "x: ";
+  int prev_id = -1;
+  for (auto graph_id : projection.graph_ids) {
+    if (graph_id != prev_id) {
+      ss << graph_id << ' ';
+      prev_id = graph_id;
+    }
+  }
+  ss << '\n';
+
+  output.push_back(ss.str(), nsupport, prev_thread_id, prev_graph_id);
+}
+
+template <typename W>
+void GBoltCore<W>::gaston_project() {
+  // Single edges, with both embeddings of an edge between equal labels
+  std::map<dfs_code_t, gaston_projection_t, dfs_code_project_compare_t> projection_map;
+  for (const auto& graph : graphs_) {
+    for (const auto& vertex : graph.vertice) {
+      for (const auto& edge : vertex.edges) {
+        const int vertex_to_label = graph.vertice[edge.to].label;
+        if (vertex.label <= vertex_to_label) {
+          dfs_code_t dfs_code{0, 1, vertex.label, edge.label, vertex_to_label};
+          gaston_projection_t &projection = projection_map[dfs_code];
+          projection.graph_ids.push_back(graph.id);
+          projection.vertice.push_back(edge.from);
+          projection.vertice.push_back(edge.to);
+        }
+      }
+    }
+  }
+
+  std::vector<GastonPattern> patterns;
+  std::vector<const gaston_projection_t *> projections;
+  std::vector<int> supports;
+  const gaston_child_t first_edge{-1, {}, {}, {}};
+  for (const auto& kv_pair : projection_map) {
+    const int nsupport = gaston_support(kv_pair.second);
+    if (nsupport < nsupport_) {
+      continue;
+    }
+    GastonPattern pattern;
+    pattern.labels = {kv_pair.first.from_label, kv_pair.first.to_label};
+    pattern.edges.push_back(gaston_edge_t{0, 1, kv_pair.first.edge_label});
+    patterns.push_back(std::move(pattern));
+    projections.push_back(&kv_pair.second);
+    supports.push_back(nsupport);
+  }
+
+  // Mine subgraphs
+  int prev_graph_id = -1;
+  int prev_thread_id = thread_id();
+
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel
+  #pragma omp single nowait
+  #endif
+  {
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      gaston_mine_child(patterns[i], *projections[i], first_edge, supports[i],
+        prev_thread_id, prev_graph_id);
+    }
+  }
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskwait
+  #endif
+}
+
+// Graphs and embeddings of an extension, counted before any occurrence is
+// copied, its index among the frequent extensions and the child it makes
+struct gaston_count_t {
+  int last_graph_id = -1;
+  int nsupport = 0;
+  int nembeddings = 0;
+  int extension = -1;
+  int child = -1;
+};
+
+// Copies the embeddings of child in parent into projection
+static void gaston_embed(
+  const gaston_projection_t &parent,
+  const gaston_child_t &child,
+  int parent_nvertice,
+  gaston_projection_t &projection) {
+  if (child.extension < 0) {
+    projection.graph_ids = parent.graph_ids;
+    projection.vertice = parent.vertice;
+    return;
+  }
+  const bool forward = parent.extensions[child.extension].to_label >= 0;
+  projection.graph_ids.reserve(child.parents.size());
+  projection.vertice.reserve(child.parents.size() * (parent_nvertice + forward));
+  for (size_t i = 0; i < child.parents.size(); ++i) {
+    const int parent_embedding = child.parents[i];
+    projection.graph_ids.push_back(parent.graph_ids[parent_embedding]);
+    const int *embedding = &parent.vertice[parent_embedding * parent_nvertice];
+    projection.vertice.insert(projection.vertice.end(), embedding,
+      embedding + parent_nvertice);
+    if (forward) {
+      projection.vertice.push_back(child.vertice[i]);
+    }
+  }
+}
+
+/*!
+Calls visit(index(extension), embedding index, graph vertex) for every
+extension of every embedding of pattern: an edge to a new graph vertex, or an
+edge closing a cycle, with -1 as the graph vertex. Cyclic patterns only close
+cycles, as each of them is a frequent spanning tree with the edges closing its
+cycles.
+
+The extensions of a child are those of its parent embedding but the one that
+made it, with the new graph vertex no longer new, and those of the pattern
+vertex it adds. Only the edges of that vertex are read from the graph, or of
+both vertices of a first edge.
+*/
+template <typename W, typename Index, typename Visit>
+static void gaston_extend(
+  const std::vector<BasicGraph<W> > &graphs,
+  const GastonPattern &pattern,
+  const gaston_projection_t &projection,
+  const gaston_projection_t &parent,
+  const gaston_child_t &child,
+  Index index,
+  Visit visit) {
+  using dfs_code_t = basic_dfs_code_t<W>;
+  const int nvertice = pattern.labels.size();
+  const bool cyclic = pattern.shape() == GastonPattern::CYCLIC;
+  // The pattern vertices whose edges are read, and the one they are attached to
+  const int extension = child.extension;
+  std::vector<std::pair<int, int> > read;
+  if (extension < 0) {
+    read = {{0, 1}, {1, 0}};
+  } else if (parent.extensions[extension].to_label >= 0) {
+    read = {{nvertice - 1, pattern.edges.back().from}};
+  }
+
+  // Index of each extension of the parent in the child, -1 if it is not one
+  std::vector<int> inherited;
+  if (extension >= 0) {
+    inherited.assign(parent.extensions.size(), -1);
+    for (size_t j = 0; j < parent.extensions.size(); ++j) {
+      const gaston_extension_t &frequent = parent.extensions[j];
+      const gaston_edge_t &edge = frequent.edge;
+      if (frequent.to_label >= 0 && !cyclic) {
+        inherited[j] = index(dfs_code_t{edge.from, nvertice, pattern.labels[edge.from],
+          edge.label, frequent.to_label});
+      } else if (frequent.to_label < 0 && static_cast<int>(j) != extension) {
+        inherited[j] = index(dfs_code_t{edge.from, edge.to, pattern.labels[edge.from],
+          edge.label, pattern.labels[edge.to]});
+      }
+    }
+  }
+
+  for (size_t i = 0; i < projection.graph_ids.size(); ++i) {
+    const int graph_id = projection.graph_ids[i];
+    if (extension >= 0) {
+      const int new_vertex = child.vertice[i];
+      const int parent_embedding = child.parents[i];
+      for (int j = parent.offsets[parent_embedding];
+        j < parent.offsets[parent_embedding + 1]; ++j) {
+        const gaston_occurrence_t &occurrence = parent.occurrences[j];
+        const int found = inherited[occurrence.extension];
+        // The new graph vertex is no longer new
+        if (found >= 0 && (occurrence.vertex < 0 || occurrence.vertex != new_vertex)) {
+          visit(found, i, occurrence.vertex);
+        }
+      }
+    }
+    if (read.empty()) {
+      continue;
+    }
+
+    const BasicGraph<W> &graph = graphs[graph_id];
+    const int *vertice = &projection.vertice[i * nvertice];
+    for (const auto& read_vertex : read) {
+      const int p = read_vertex.first;
+      const int attached = vertice[read_vertex.second];
+      for (const auto& edge : graph.vertice[vertice[p]].edges) {
+        if (edge.to == attached) {
+          continue;
+        }
+        // The few edges read are looked up in the embedding, rather than
+        // mapping all of its vertices
+        const int q = std::find(vertice, vertice + nvertice, edge.to) - vertice;
+        if (q < nvertice) {
+          visit(index(dfs_code_t{q, p, pattern.labels[q], edge.label, pattern.labels[p]}),
+            i, -1);
+        } else if (!cyclic) {
+          visit(index(dfs_code_t{p, nvertice, pattern.labels[p], edge.label,
+            graph.vertice[edge.to].label}), i, edge.to);
+        }
+      }
+    }
+  }
+}
+
+template <typename W>
+int GBoltCore<W>::gaston_mine_subgraph(
+  const GastonPattern &pattern,
+  gaston_projection_t &projection,
+  const gaston_projection_t &parent,
+  const gaston_child_t &child) {
+  gbolt_instance_t& instance = thread_instance();
+
+  const int prev_thread_id = thread_id();
+  const int prev_graph_id = instance.output.size() - 1;
+  const int nvertice = pattern.labels.size();
+
+  // Extensions are counted in a table indexed by the pattern vertex extended,
+  // and the dense labels of a new vertex or the vertex a cycle is closed to
+  const int nedge_labels = frequent_edge_labels_.size();
+  const int nvertex_labels = frequent_vertex_labels_.size();
+  const int nforward = nvertice * nedge_labels * nvertex_labels;
+  const auto index = [=](const dfs_code_t &extension) {
+    return extension.to == nvertice ?
+      (extension.from * nedge_labels + extension.edge_label) * nvertex_labels + extension.to_label :
+      nforward + (extension.from * nvertice + extension.to) * nedge_labels + extension.edge_label;
+  };
+  std::vector<gaston_count_t> counts(nforward + nvertice * nvertice * nedge_labels);
+
+  // Count the graphs of every extension, keeping its occurrences by table index
+  // until the frequent ones are known
+  projection.offsets.reserve(projection.graph_ids.size() + 1);
+  gaston_extend(graphs_, pattern, projection, parent, child, index,
+    [&](int found, size_t i, int to) {
+      gaston_count_t &count = counts[found];
+      const int graph_id = projection.graph_ids[i];
+      if (count.last_graph_id != graph_id) {
+        count.last_graph_id = graph_id;
+        ++count.nsupport;
+      }
+      ++count.nembeddings;
+      while (projection.offsets.size() <= i) {
+        projection.offsets.push_back(projection.occurrences.size());
+      }
+      projection.occurrences.push_back(gaston_occurrence_t{found, to});
+    });
+  projection.offsets.resize(projection.graph_ids.size() + 1, projection.occurrences.size());
+
+  // Paths and free trees are only grown from their canonical parent, cyclic
+  // patterns only the first time their key is seen. Isomorphic extensions of
+  // this pattern are kept once.
+  // Cyclic patterns have no extension to a new vertex
+  const bool cyclic = pattern.shape() == GastonPattern::CYCLIC;
+  const std::string key = cyclic || !child.key.empty() ? child.key : pattern.key();
+  const std::vector<bool> leaf_parents = cyclic ? std::vector<bool>() : pattern.leaf_parents();
+  std::unordered_set<std::string> child_keys;
+  std::vector<GastonPattern> patterns;
+  std::vector<gaston_child_t> children;
+  std::vector<int> shapes;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    gaston_count_t &count = counts[i];
+    if (count.nsupport < nsupport_) {
+      continue;
+    }
+    count.extension = projection.extensions.size();
+    gaston_extension_t frequent;
+    if (static_cast<int>(i) < nforward) {
+      frequent.edge = gaston_edge_t{static_cast<int>(i) / (nedge_labels * nvertex_labels),
+        nvertice, static_cast<int>(i / nvertex_labels % nedge_labels)};
+      frequent.to_label = i % nvertex_labels;
+    } else {
+      const int backward = i - nforward;
+      frequent.edge = gaston_edge_t{backward / nedge_labels / nvertice,
+        backward / nedge_labels % nvertice, backward % nedge_labels};
+      frequent.to_label = -1;
+    }
+    frequent.nsupport = count.nsupport;
+    frequent.nembeddings = count.nembeddings;
+    projection.extensions.push_back(frequent);
+
+    const bool forward = frequent.to_label >= 0;
+    if (forward && !leaf_parents[frequent.edge.from]) {
+      continue;
+    }
+    GastonPattern grown = pattern;
+    if (forward) {
+      grown.labels.push_back(frequent.to_label);
+    }
+    grown.edges.push_back(frequent.edge);
+    const GastonPattern::shape_t shape = grown.shape();
+    if (shape != GastonPattern::CYCLIC && !grown.canonical_parent(key)) {
+      continue;
+    }
+    std::string grown_key = grown.key();
+    if (shape == GastonPattern::CYCLIC ? !gaston_keys_.insert(grown_key) :
+      !child_keys.insert(grown_key).second) {
+      continue;
+    }
+    count.child = children.size();
+    children.push_back(gaston_child_t{count.extension, {}, {}, std::move(grown_key)});
+    children.back().parents.reserve(count.nembeddings);
+    children.back().vertice.reserve(count.nembeddings);
+    shapes.push_back(shape);
+    patterns.push_back(std::move(grown));
+  }
+
+  // Keep the occurrences of the frequent extensions, which the children of
+  // this pattern inherit, and record where the children occur
+  int nkept = 0;
+  for (size_t i = 0; i < projection.graph_ids.size(); ++i) {
+    const int begin = projection.offsets[i];
+    projection.offsets[i] = nkept;
+    for (int j = begin; j < projection.offsets[i + 1]; ++j) {
+      const gaston_occurrence_t found = projection.occurrences[j];
+      const gaston_count_t &count = counts[found.extension];
+      if (count.extension == -1) {
+        continue;
+      }
+      projection.occurrences[nkept++] = gaston_occurrence_t{count.extension, found.vertex};
+      if (count.child != -1) {
+        children[count.child].parents.push_back(i);
+        children[count.child].vertice.push_back(found.vertex);
+      }
+    }
+  }
+  projection.offsets.back() = nkept;
+  projection.occurrences.resize(nkept);
+  projection.occurrences.shrink_to_fit();
+  std::vector<gaston_count_t>().swap(counts);
+
+  // Mine paths, then free trees, then cyclic patterns
+  for (auto shape : {GastonPattern::PATH, GastonPattern::TREE, GastonPattern::CYCLIC}) {
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      if (shapes[i] == shape) {
+        gaston_mine_child(patterns[i], projection, children[i],
+          projection.extensions[children[i].extension].nsupport, prev_thread_id, prev_graph_id);
+      }
+    }
+  }
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskwait
+  #endif
+  return patterns.size();
+}
+
+template <typename W>
+void GBoltCore<W>::gaston_mine_child(
+  const GastonPattern &pattern,
+  const gaston_projection_t &parent,
+  const gaston_child_t &child,
+  int nsupport,
+  int prev_thread_id,
+  int prev_graph_id) {
+  progress_spawned(pattern.edges.size());
+  #ifndef GBOLT_SERIAL
+  #pragma omp task shared(pattern, parent, child) firstprivate(nsupport, prev_thread_id, prev_graph_id)
+  #endif
+  {
+    const int64_t start = trace_ ? Trace::now() : 0;
+    gbolt_instance_t& instance = thread_instance();
+    gaston_projection_t projection;
+    const int parent_nvertice = pattern.labels.size() -
+      (child.extension >= 0 && parent.extensions[child.extension].to_label >= 0);
+    gaston_embed(parent, child, parent_nvertice, projection);
+    instance.report(pattern, projection, nsupport, prev_thread_id, prev_graph_id);
+    const int nchildren = gaston_mine_subgraph(pattern, projection, parent, child);
+    if (trace_) {
+      instance.trace.push_back(trace_event_t(start, Trace::now(), pattern.edges.size(),
+        projection.graph_ids.size(), nsupport, nchildren, true));
+    }
+    progress_finished(pattern.edges.size());
+  }
+}
+
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::gaston_project();
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
+}  // namespace gbolt
@@ -0,0 +1,302 @@
+#include <gbolt.h>
+#include <common.h>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace gbolt {
+
+// Supporting graphs of a pattern, old ones first, and its id once reported
+struct lattice_entry_t {
+  std::vector<int> graph_ids;
+  int output_id = -1;
+};
+
+using Lattice = std::map<std::vector<wide_dfs_code_t>, lattice_entry_t, dfs_codes_less_t>;
+
+// Child of a trie node with the given code, or -1
+template <typename Node, typename Code>
+static int find_child(const std::vector<Node> &nodes, int node, const Code &code) {
+  for (auto child : nodes[node].children) {
+    if (nodes[child].code == code) {
+      return child;
+    }
+  }
+  return -1;
+}
+
+template <typename W>
+void GBoltCore<W>::execute_incremental() {
+  #ifdef GBOLT_PERFORMANCE
+  struct timeval time_start, time_end;
+  double elapsed = 0.0;
+  CPU_TIMER_START(elapsed, time_start);
+  #endif
+
+  init_instances();
+
+  const int ngraphs = graphs_.size();
+  const int nold = state_.ngraphs;
+  const int nsupport = ngraphs * support_;
+  const int nborder = std::max(static_cast<int>(ngraphs * border_), 1);
+
+  // A pattern missing from the loaded state has less than its border support
+  // in the old graphs, so it needs at least this support in the appended
+  // graphs to reach the new border
+  const int old_border = std::max(state_.nborder, 1);
+  if (nborder < old_border) {
+    LOG_ERROR("Border support %d is below the %d of the state, mine from scratch",
+      nborder, old_border);
+  }
+
+  // Every prefix of a state pattern is in the state, so every node of its
+  // trie holds the pattern ending there
+  query_nodes_.assign(1, query_node_t());
+  for (size_t i = 0; i < state_.patterns.size(); ++i) {
+    insert_query(state_.patterns[i].dfs_codes, i);
+  }
+  query_graph_ids_.assign(state_.patterns.size(), std::vector<int>());
+
+  // Walk the state through the embeddings of the appended graphs. Patterns
+  // crossing the border are mined in all graphs and collected.
+  nsupport_ = nborder;
+  collect_ = true;
+  ProjectionMap projection_map;
+  first_graph_ = nold;
+  project(projection_map);
+  first_graph_ = 0;
+  ProjectionMap all_projection_map;
+  bool mine_first = false;
+
+  DfsCodes dfs_codes;
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel
+  #pragma omp single nowait
+  #endif
+  {
+    for (auto it = projection_map.begin(); it != projection_map.end(); ++it) {
+      const int child = find_child(query_nodes_, 0, it->first);
+      if (child == -1) {
+        mine_first = mine_first || count_support(it->second) + old_border - 1 >= nborder;
+        continue;
+      }
+      #ifndef GBOLT_SERIAL
+      #pragma omp task firstprivate(it, dfs_codes, child)
+      #endif
+      {
+        dfs_codes.push_back(&query_nodes_[child].code);
+        incremental_subgraph(it->second, child, dfs_codes, parent_graphs_t());
+        #ifdef GBOLT_SERIAL
+        dfs_codes.pop_back();
+        #endif
+      }
+    }
+    if (mine_first) {
+      project(all_projection_map);
+      for (const auto& kv_pair : all_projection_map) {
+        if (find_child(query_nodes_, 0, kv_pair.first) == -1) {
+          mine_child(kv_pair.second, kv_pair.first, dfs_codes, thread_id(), -1);
+        }
+      }
+    }
+  }
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskwait
+  #endif
+  collect_ = false;
+
+  #ifdef GBOLT_PERFORMANCE
+  CPU_TIMER_END(elapsed, time_start, time_end);
+  LOG_INFO("gbolt mine appended graphs time: %f", elapsed);
+  CPU_TIMER_START(elapsed, time_start);
+  #endif
+
+  // Patterns below the border are neither reported nor kept, and neither are
+  // their children
+  Lattice lattice;
+  for (size_t i = 0; i < state_.patterns.size(); ++i) {
+    pattern_t &pattern = state_.patterns[i];
+    if (pattern.graph_ids.size() + query_graph_ids_[i].size() < static_cast<size_t>(nborder)) {
+      continue;
+    }
+    lattice_entry_t &entry = lattice[std::move(pattern.dfs_codes)];
+    entry.graph_ids = std::move(pattern.graph_ids);
+    entry.graph_ids.insert(entry.graph_ids.end(),
+      query_graph_ids_[i].begin(), query_graph_ids_[i].end());
+  }
+  state_.patterns.clear();
+  query_nodes_.clear();
+  query_graph_ids_.clear();
+  for (auto& instance : gbolt_instances_) {
+    for (auto& pattern : instance.patterns) {
+      lattice[std::move(pattern.dfs_codes)].graph_ids = std::move(pattern.graph_ids);
+    }
+    instance.patterns.clear();
+  }
+
+  // Report in DFS code order from a single thread, so that every parent is
+  // reported before its children and the output is deterministic
+  state_t state;
+  state.ngraphs = ngraphs;
+  state.border = border_;
+  state.nborder = nborder;
+  state.vertex_labels = frequent_vertex_labels_;
+  state.edge_labels = frequent_edge_labels_;
+  gbolt_instance_t &instance = gbolt_instances_[0];
+  for (auto& kv_pair : lattice) {
+    lattice_entry_t &entry = kv_pair.second;
+    const int support = entry.graph_ids.size();
+    if (support >= nsupport) {
+      int parent_id = -1;
+      if (kv_pair.first.size() > 1) {
+        parent_id = lattice.find(std::vector<wide_dfs_code_t>(
+          kv_pair.first.begin(), kv_pair.first.end() - 1))->second.output_id;
+      }
+      const std::vector<dfs_code_t> codes(kv_pair.first.begin(), kv_pair.first.end());
+      dfs_codes.clear();
+      for (const auto& code : codes) {
+        dfs_codes.push_back(&code);
+      }
+      entry.output_id = instance.output.size();
+      instance.build_min_graph(dfs_codes);
+      instance.report(dfs_codes, entry.graph_ids, support, 0, parent_id);
+    }
+    state.patterns.push_back(pattern_t{kv_pair.first, std::move(entry.graph_ids)});
+  }
+  // Frequent nodes are saved with the output support
+  nsupport_ = nsupport;
+
+  #ifdef GBOLT_PERFORMANCE
+  CPU_TIMER_END(elapsed, time_start, time_end);
+  LOG_INFO("gbolt merge state time: %f, %zu patterns kept",
+    elapsed, state.patterns.size());
+  #endif
+
+  if (!state_out_.empty()) {
+    state.write(state_out_);
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::incremental_subgraph(
+  const Projection &projection,
+  int node,
+  DfsCodes &dfs_codes,
+  const parent_graphs_t &parent_graphs) {
+  const query_node_t &query_node = query_nodes_[node];
+  const int pattern = query_node.queries[0];
+  std::vector<int> &graph_ids = query_graph_ids_[pattern];
+  for (const auto& run : projection.runs()) {
+    graph_ids.push_back(run.id);
+  }
+  // Descendants have at most as many old and appended graphs
+  const std::vector<int> &old_ids = state_.patterns[pattern].graph_ids;
+  const int nold_support = old_ids.size();
+  if (nold_support + count_support(graph_ids) < nsupport_) {
+    return;
+  }
+
+  // Tasks running on this thread while waiting overwrite the rightmost path
+  // of the instance
+  gbolt_instance_t& instance = thread_instance();
+  instance.update_right_most_path(dfs_codes, dfs_codes.size());
+  const std::vector<int> right_most_path = instance.right_most_path;
+
+  ChildGraphsMapBackward child_graphs_backward;
+  ChildGraphsMapForward child_graphs_forward;
+  enumerate(dfs_codes, projection, right_most_path,
+    child_graphs_backward, child_graphs_forward);
+  std::vector<std::pair<const dfs_code_t *, const std::vector<int> *> > children;
+  for (const auto& kv_pair : child_graphs_backward) {
+    children.emplace_back(&kv_pair.first, &kv_pair.second.graph_ids);
+  }
+  const size_t nbackward = children.size();
+  for (const auto& kv_pair : child_graphs_forward) {
+    children.emplace_back(&kv_pair.first, &kv_pair.second.graph_ids);
+  }
+
+  // Children missing from the state have less than the old border in the old
+  // graphs, and at most as many as the pattern
+  const int max_old_support = std::min(std::max(state_.nborder - 1, 0), nold_support);
+  std::vector<int> child_nodes(children.size());
+  bool mine_children = false;
+  for (size_t i = 0; i < children.size(); ++i) {
+    child_nodes[i] = find_child(query_nodes_, node, *children[i].first);
+    if (child_nodes[i] == -1 &&
+      count_support(*children[i].second) + max_old_support >= nsupport_) {
+      mine_children = true;
+    }
+  }
+
+  // Only then are the old graphs embedded, to count those children exactly
+  std::vector<Projection> levels;
+  ChildGraphsMapBackward all_graphs_backward;
+  ChildGraphsMapForward all_graphs_forward;
+  if (mine_children) {
+    if (parent_graphs.projection != nullptr) {
+      levels.resize(1);
+      materialize(dfs_codes, *parent_graphs.projection, *parent_graphs.right_most_path,
+        *parent_graphs.graph_ids, levels[0]);
+    } else {
+      std::vector<int> all_ids(old_ids);
+      all_ids.insert(all_ids.end(), graph_ids.begin(), graph_ids.end());
+      embed(dfs_codes, all_ids, levels);
+    }
+    enumerate(dfs_codes, levels.back(), right_most_path,
+      all_graphs_backward, all_graphs_forward);
+  }
+
+  for (size_t i = 0; i < children.size(); ++i) {
+    const int child = child_nodes[i];
+    if (child == -1) {
+      continue;
+    }
+    // A child is in the graphs of its appended embeddings
+    parent_graphs_t child_parent_graphs;
+    if (mine_children) {
+      child_parent_graphs.projection = &levels.back();
+      child_parent_graphs.right_most_path = &right_most_path;
+      child_parent_graphs.graph_ids = i < nbackward ?
+        &all_graphs_backward.find(*children[i].first)->second.graph_ids :
+        &all_graphs_forward.find(*children[i].first)->second.graph_ids;
+    }
+    #ifndef GBOLT_SERIAL
+    #pragma omp task shared(projection, right_most_path, children) \
+      firstprivate(dfs_codes, child, i, child_parent_graphs)
+    #endif
+    {
+      dfs_codes.push_back(&query_nodes_[child].code);
+      Projection child_projection;
+      materialize(dfs_codes, projection, right_most_path, *children[i].second, child_projection);
+      incremental_subgraph(child_projection, child, dfs_codes, child_parent_graphs);
+      #ifdef GBOLT_SERIAL
+      dfs_codes.pop_back();
+      #endif
+    }
+  }
+
+  if (mine_children) {
+    for (auto it = all_graphs_backward.begin(); it != all_graphs_backward.end(); ++it) {
+      if (find_child(query_nodes_, node, it->first) == -1) {
+        mine_child(levels.back(), right_most_path, it->first, it->second.graph_ids,
+          dfs_codes, thread_id(), -1);
+      }
+    }
+    for (auto it = all_graphs_forward.rbegin(); it != all_graphs_forward.rend(); ++it) {
+      if (find_child(query_nodes_, node, it->first) == -1) {
+        mine_child(levels.back(), right_most_path, it->first, it->second.graph_ids,
+          dfs_codes, thread_id(), -1);
+      }
+    }
+  }
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskwait
+  #endif
+}
+
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::execute_incremental();
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
+}  // namespace gbolt
@@ -1,15 +1,60 @@
 #include <gbolt.h>
 #include <graph.h>
+#include <common.h>
 #include <sstream>
 #include <database.h>
 #include <unordered_set>
+#include <fstream>
+#include <limits>
+#include <algorithm>
 
 namespace gbolt {
 
-void GBolt::find_frequent_nodes_and_edges(const Database& db) {
+// Assign dense ids to the given fixed labels, then to the other labels with at
+// least nsupport, from the least to the most frequent one, or the other way
+// round if most_frequent_first. Returns the original labels, indexed by dense id.
+static std::vector<int> dense_labels(
+  const std::unordered_map<int, int> &label_support, int nsupport,
+  const std::vector<int> &fixed_labels, bool most_frequent_first,
+  std::unordered_map<int, int> &label_ids) {
+  std::vector<int> labels;
+  for (auto label : fixed_labels) {
+    label_ids[label] = labels.size();
+    labels.push_back(label);
+  }
+
+  std::vector<std::pair<int, int> > frequent_labels;
+  for (const auto& kv_pair : label_support) {
+    if (kv_pair.second >= nsupport && label_ids.count(kv_pair.first) == 0) {
+      frequent_labels.emplace_back(kv_pair.second, kv_pair.first);
+    }
+  }
+  // Ties are broken by the original label, to keep runs deterministic
+  if (most_frequent_first) {
+    std::sort(frequent_labels.begin(), frequent_labels.end(),
+      [](const std::pair<int, int> &first, const std::pair<int, int> &second) {
+        return first.first != second.first ? first.first > second.first :
+          first.second < second.second;
+      });
+  } else {
+    std::sort(frequent_labels.begin(), frequent_labels.end());
+  }
+
+  for (const auto& frequent_label : frequent_labels) {
+    label_ids[frequent_label.second] = labels.size();
+    labels.push_back(frequent_label.second);
+  }
+  return labels;
+}
+
+void GBoltBase::find_frequent_nodes_and_edges(const Database& db,
+  std::unordered_map<int, int> &vertex_label_ids,
+  std::unordered_map<int, int> &edge_label_ids) {
   std::unordered_map<int, std::vector<int> > vertex_labels;
   std::unordered_map<int, int> edge_labels;
 
+  std::unordered_map<int, int> vertex_support;
+
   const auto& graphs = db.get_graphs();
   for (auto i = 0; static_cast<size_t>(i) < graphs.size(); ++i) {
     std::unordered_set<int> vertex_set;
@@ -23,127 +68,635 @@ void GBolt::find_frequent_nodes_and_edges(const Database& db) {
     for (auto label : vertex_set) {
       vertex_labels[label].emplace_back(i);
     }
-    for (auto label : edge_set) {
-      ++edge_labels[label];
+    if (mni_support_ == 0) {
+      for (auto label : edge_set) {
+        ++edge_labels[label];
+      }
+      continue;
     }
-  }
-  for (const auto& kv_pair : vertex_labels) {
-    if (kv_pair.second.size() >= static_cast<size_t>(nsupport_)) {
-      frequent_vertex_labels_.insert(kv_pair);
+    // Minimum image based support: a vertex label is supported by each vertex
+    // carrying it, and a pattern with an edge label can at most map its end
+    // vertices to the distinct vertices touching edges with this label
+    for (const auto& vertex : graphs[i].vertices) {
+      ++vertex_support[vertex.label];
+    }
+    std::unordered_set<int64_t> edge_vertex_set;
+    for (const auto& edge : graphs[i].edges) {
+      if (edge_vertex_set.insert((static_cast<int64_t>(edge.label) << 32) |
+        static_cast<uint32_t>(edge.from)).second) {
+        ++edge_labels[edge.label];
+      }
+      if (edge_vertex_set.insert((static_cast<int64_t>(edge.label) << 32) |
+        static_cast<uint32_t>(edge.to)).second) {
+        ++edge_labels[edge.label];
+      }
     }
   }
-  for (const auto& kv_pair : edge_labels) {
-    if (kv_pair.second >= nsupport_) {
-      frequent_edge_labels_.insert(kv_pair);
+
+  if (mni_support_ == 0) {
+    for (const auto& kv_pair : vertex_labels) {
+      vertex_support[kv_pair.first] = kv_pair.second.size();
     }
   }
+  // Patterns of a loaded state keep their labels. Rare vertex labels start
+  // the minimal DFS code, while frequent edge labels come first among the
+  // extensions of a vertex: putting rare edge labels first enumerates more
+  // embeddings on chemical datasets.
+  frequent_vertex_labels_ = dense_labels(vertex_support, nsupport_,
+    state_.vertex_labels, false, vertex_label_ids);
+  frequent_edge_labels_ = dense_labels(edge_labels, nsupport_,
+    state_.edge_labels, true, edge_label_ids);
+
+  for (auto label : frequent_vertex_labels_) {
+    frequent_vertex_support_.push_back(vertex_support[label]);
+    frequent_vertex_graphs_.emplace_back(std::move(vertex_labels[label]));
+  }
 }
 
-void gbolt_instance_t::report(const DfsCodes &dfs_codes,
-  const Projection &projection, int nsupport,
-  int prev_thread_id, int prev_graph_id) {
-  std::stringstream ss;
+// Merged output key of a DFS code sequence. Big-endian ids and labels compare
+// like the codes themselves, and a pattern sorts before its children.
+static const size_t dfs_code_key_size = 5 * 4;
+
+template <typename W>
+static std::string dfs_codes_key(const BasicDfsCodes<W> &dfs_codes) {
+  std::string key;
+  for (const auto code : dfs_codes) {
+    const int values[] = {code->from, code->to, code->from_label, code->edge_label,
+      code->to_label};
+    for (auto value : values) {
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        key.push_back(static_cast<char>((value >> shift) & 0xff));
+      }
+    }
+  }
+  return key;
+}
 
+template <typename W>
+void basic_gbolt_instance_t<W>::report_pattern(const DfsCodes &dfs_codes, std::stringstream &ss) {
   // Min_graph is guaranteed to be built already.
   for (const auto& vertex : min_graph.vertice) {
-    ss << "v " << vertex.id << ' ' << vertex.label << '\n';
+    ss << "v " << vertex.id << ' ' << vertex_labels[vertex.label] << '\n';
   }
   for (const auto edge : dfs_codes) {
     ss << "e " << edge->from << ' ' << edge->to
-      << ' ' << edge->edge_label << '\n';
+      << ' ' << edge_labels[edge->edge_label] << '\n';
   }
+}
+
+template <typename W>
+void basic_gbolt_instance_t<W>::report_graph_ids(const std::vector<int> &graph_ids,
+  std::stringstream &ss) {
   ss << "x: ";
-  int prev_id = -1;
-  for (const auto& link : projection) {
-    if (link.id != prev_id) {
-      prev_id = link.id;
-      ss << prev_id << ' ';
+  if (duplicate_graphs == nullptr) {
+    for (auto graph_id : graph_ids) {
+      ss << graph_id << ' ';
+    }
+  } else {
+    // Duplicates follow their representative, so the ids are sorted again
+    std::vector<int> expanded_ids;
+    for (auto graph_id : graph_ids) {
+      expanded_ids.push_back(graph_id);
+      const auto& duplicates = (*duplicate_graphs)[graph_id];
+      expanded_ids.insert(expanded_ids.end(), duplicates.begin(), duplicates.end());
+    }
+    std::sort(expanded_ids.begin(), expanded_ids.end());
+    for (auto graph_id : expanded_ids) {
+      ss << graph_id << ' ';
     }
   }
   ss << '\n';
+}
 
-  output.push_back(ss.str(), nsupport, prev_thread_id, prev_graph_id);
+template <typename W>
+void basic_gbolt_instance_t<W>::report_classes(const Projection &projection, std::stringstream &ss) {
+  std::vector<int> supports(nclasses, 0);
+  for (const auto& run : projection.runs()) {
+    ++supports[(*graph_classes)[run.id]];
+  }
+  ss << "c: ";
+  for (auto support : supports) {
+    ss << support << ' ';
+  }
+  ss << '\n';
 }
 
-void GBolt::save(bool output_parent, bool output_pattern, bool output_frequent_nodes) {
-  #ifndef GBOLT_SERIAL
-  #pragma omp parallel
-  #endif
-  {
-    thread_instance().output.save(output_parent, output_pattern);
+template <typename W>
+void basic_gbolt_instance_t<W>::report(const DfsCodes &dfs_codes,
+  const Projection &projection, int nsupport,
+  int prev_thread_id, int prev_graph_id) {
+  PerfScope scope(counters, PHASE_REPORT);
+  if (progress != nullptr) {
+    progress_add(progress->patterns);
+  }
+  std::stringstream ss;
+
+  report_pattern(dfs_codes, ss);
+  if (graph_classes != nullptr) {
+    report_classes(projection, ss);
+  }
+  if (duplicate_graphs != nullptr) {
+    std::vector<int> graph_ids;
+    for (const auto& run : projection.runs()) {
+      graph_ids.push_back(run.id);
+    }
+    report_graph_ids(graph_ids, ss);
+  } else {
+    ss << "x: ";
+    for (const auto& run : projection.runs()) {
+      ss << run.id << ' ';
+    }
+    ss << '\n';
+  }
+
+  output.push_back(ss.str(), nsupport, prev_thread_id, prev_graph_id,
+    output.keeps_keys() ? dfs_codes_key(dfs_codes) : std::string());
+}
+
+template <typename W>
+void basic_gbolt_instance_t<W>::report(const DfsCodes &dfs_codes,
+  const std::vector<int> &graph_ids, int nsupport,
+  int prev_thread_id, int prev_graph_id) {
+  PerfScope scope(counters, PHASE_REPORT);
+  if (progress != nullptr) {
+    progress_add(progress->patterns);
+  }
+  std::stringstream ss;
+
+  report_pattern(dfs_codes, ss);
+  report_graph_ids(graph_ids, ss);
+
+  output.push_back(ss.str(), nsupport, prev_thread_id, prev_graph_id,
+    output.keeps_keys() ? dfs_codes_key(dfs_codes) : std::string());
+}
+
+template <typename W>
+void basic_gbolt_instance_t<W>::collect(const DfsCodes &dfs_codes, const Projection &projection) {
+  if (progress != nullptr) {
+    progress_add(progress->patterns);
+  }
+  patterns.emplace_back();
+  pattern_t &pattern = patterns.back();
+  for (const auto code : dfs_codes) {
+    pattern.dfs_codes.emplace_back(*code);
+  }
+  for (const auto& run : projection.runs()) {
+    pattern.graph_ids.push_back(run.id);
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::save(bool output_parent, bool output_pattern, bool output_frequent_nodes) {
+  // Every support gets its own output set, with the ids of the lowest one
+  std::vector<std::pair<std::string, int> > output_sets;
+  if (output_supports_.size() <= 1) {
+    output_sets.emplace_back(output_file_, 0);
+  } else {
+    for (auto support : output_supports_) {
+      std::stringstream ss;
+      ss << output_file_ << ".s" << support;
+      output_sets.emplace_back(ss.str(), static_cast<int>(graphs_.size() * support));
+    }
+  }
+
+  if (merge_output_) {
+    std::vector<const Output *> outputs;
+    for (const auto& instance : gbolt_instances_) {
+      outputs.push_back(&instance.output);
+    }
+    for (const auto& output_set : output_sets) {
+      // Gaston reports a pattern from whichever isomorphic generation comes
+      // first, its parent is the pattern of its DFS code prefix instead
+      Output::save_merged(outputs, output_set.first, output_parent, output_pattern,
+        output_set.second, gaston_ ? dfs_code_key_size : 0);
+    }
+  } else {
+    #ifndef GBOLT_SERIAL
+    #pragma omp parallel
+    #endif
+    {
+      const std::string thread_suffix = ".t" + std::to_string(thread_id());
+      for (const auto& output_set : output_sets) {
+        thread_instance().output.save(output_set.first + thread_suffix,
+          output_parent, output_pattern, output_set.second);
+      }
+    }
   }
   // Save output for frequent nodes
   if (output_frequent_nodes) {
-    std::string output_file_nodes = output_file_ + ".nodes";
-    Output output_frequent_nodes_(output_file_nodes);
+    Output output_frequent_nodes_(output_file_ + ".nodes");
 
-    for (const auto& kv_pair : frequent_vertex_labels_) {
+    for (size_t i = 0; i < frequent_vertex_labels_.size(); ++i) {
+      // Incremental mining keeps labels down to the border support
+      if (frequent_vertex_support_[i] < nsupport_) {
+        continue;
+      }
       std::stringstream ss;
 
-      ss << "v 0 " << kv_pair.first;
+      ss << "v 0 " << frequent_vertex_labels_[i];
       ss << '\n';
       ss << "x: ";
-      for (auto g_id : kv_pair.second) {
+      for (auto g_id : frequent_vertex_graphs_[i]) {
         ss << g_id << ' ';
       }
       ss << '\n';
 
-      output_frequent_nodes_.push_back(ss.str(), kv_pair.second.size());
+      output_frequent_nodes_.push_back(ss.str(), frequent_vertex_support_[i]);
+    }
+    for (const auto& output_set : output_sets) {
+      output_frequent_nodes_.save(output_set.first + ".nodes", false, true, output_set.second);
+    }
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::save_trace(const std::string &trace_file) const {
+  std::ofstream out(trace_file);
+
+  if (!out.is_open()) {
+    LOG_ERROR("Open file error! %s", trace_file.c_str());
+  }
+
+  // Align all threads to the earliest recorded task
+  int64_t epoch = std::numeric_limits<int64_t>::max();
+  for (const auto& instance : gbolt_instances_) {
+    if (!instance.trace.empty()) {
+      epoch = std::min(epoch, instance.trace.start());
     }
-    output_frequent_nodes_.save(false, true);
   }
+
+  bool first = true;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < gbolt_instances_.size(); ++i) {
+    gbolt_instances_[i].trace.save(out, i, epoch, first);
+  }
+  out << "\n]}\n";
+}
+
+bool GBoltBase::enable_counters(std::string &error) {
+  #ifdef GBOLT_SERIAL
+  ncounters_ = 1;
+  #else
+  ncounters_ = omp_get_max_threads();
+  #endif
+  counters_.reset(new PerfCounters[ncounters_]);
+  // Other threads open theirs when they first count a phase
+  if (!counters_[thread_id()].open(error)) {
+    counters_.reset();
+    ncounters_ = 0;
+    return false;
+  }
+  return true;
 }
 
-void GBolt::mine_subgraph(
+void GBoltBase::report_counters() const {
+  if (!counters_) {
+    return;
+  }
+  for (int phase = 0; phase < NPHASES; ++phase) {
+    uint64_t calls = 0;
+    uint64_t counts[NEVENTS] = {0};
+    for (int i = 0; i < ncounters_; ++i) {
+      calls += counters_[i].calls(phase);
+      for (int event = 0; event < NEVENTS; ++event) {
+        counts[event] += counters_[i].count(phase, event);
+      }
+    }
+    if (calls == 0) {
+      continue;
+    }
+
+    // Misses are per thousand instructions, events the hardware lacks are n/a
+    const PerfCounters &counters = counters_[thread_id()];
+    const double instructions = counts[EVENT_INSTRUCTIONS];
+    char ipc[32] = "n/a";
+    char llc_misses[64] = "n/a";
+    char branch_misses[64] = "n/a";
+    if (counters.available(EVENT_INSTRUCTIONS) && counts[EVENT_CYCLES] != 0) {
+      snprintf(ipc, sizeof(ipc), "%.3f", instructions / counts[EVENT_CYCLES]);
+    }
+    if (counters.available(EVENT_LLC_MISSES)) {
+      snprintf(llc_misses, sizeof(llc_misses), "%llu (%.3f mpki)",
+        static_cast<unsigned long long>(counts[EVENT_LLC_MISSES]),
+        instructions != 0 ? 1000.0 * counts[EVENT_LLC_MISSES] / instructions : 0.0);
+    }
+    if (counters.available(EVENT_BRANCH_MISSES)) {
+      snprintf(branch_misses, sizeof(branch_misses), "%llu (%.3f mpki)",
+        static_cast<unsigned long long>(counts[EVENT_BRANCH_MISSES]),
+        instructions != 0 ? 1000.0 * counts[EVENT_BRANCH_MISSES] / instructions : 0.0);
+    }
+    LOG_INFO("gbolt counters %s: calls %llu cycles %llu instructions %llu ipc %s llc misses %s branch misses %s",
+      counter_phase_name(phase), static_cast<unsigned long long>(calls),
+      static_cast<unsigned long long>(counts[EVENT_CYCLES]),
+      static_cast<unsigned long long>(counts[EVENT_INSTRUCTIONS]),
+      ipc, llc_misses, branch_misses);
+  }
+}
+
+// Projections with at least this many embeddings count the graphs of their
+// children first, and materialize only the frequent and minimal ones
+static const size_t count_first_embeddings = 4096;
+
+template <typename W>
+int GBoltCore<W>::mine_subgraph(
+  const Projection &projection,
+  DfsCodes &dfs_codes,
+  int prev_thread_id,
+  int prev_graph_id) {
+  gbolt_instance_t& instance = thread_instance();
+  // The is_min of the children overwrites the rightmost path of the instance
+  const std::vector<int> right_most_path = instance.right_most_path;
+
+  // Recursive mining: first backward, last backward, and then last forward to the first forward
+  int nchildren = 0;
+  const bool count_first = mni_support_ == 0 &&
+    (projection.size() >= count_first_embeddings || switch_embedding_free(projection));
+  if (!count_first) {
+    // Minimum image based support is counted from the embeddings of every
+    // child, and small projections are cheaper to extend in one pass than to
+    // count and then materialize
+    ProjectionMapBackward projection_map_backward;
+    ProjectionMapForward projection_map_forward;
+    enumerate(dfs_codes, projection, right_most_path,
+      projection_map_backward, projection_map_forward);
+    for (auto it = projection_map_backward.begin(); it != projection_map_backward.end(); ++it) {
+      nchildren += mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
+    }
+    for (auto it = projection_map_forward.rbegin(); it != projection_map_forward.rend(); ++it) {
+      nchildren += mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
+    }
+    #ifndef GBOLT_SERIAL
+    #pragma omp taskwait
+    #endif
+    return nchildren;
+  }
+
+  // Enumerate backward paths and forward paths by different rules, only
+  // counting the supporting graphs of each child
+  ChildGraphsMapBackward child_graphs_backward;
+  ChildGraphsMapForward child_graphs_forward;
+  enumerate(dfs_codes, projection, right_most_path,
+    child_graphs_backward, child_graphs_forward);
+  if (switch_embedding_free(projection)) {
+    // Children only keep their graph ids
+    GraphIdsMapBackward graph_ids_map_backward;
+    GraphIdsMapForward graph_ids_map_forward;
+    for (auto& kv_pair : child_graphs_backward) {
+      graph_ids_map_backward.emplace(kv_pair.first, std::move(kv_pair.second.graph_ids));
+    }
+    for (auto& kv_pair : child_graphs_forward) {
+      graph_ids_map_forward.emplace(kv_pair.first, std::move(kv_pair.second.graph_ids));
+    }
+    child_graphs_backward.clear();
+    child_graphs_forward.clear();
+    for (auto it = graph_ids_map_backward.begin(); it != graph_ids_map_backward.end(); ++it) {
+      nchildren += mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
+    }
+    for (auto it = graph_ids_map_forward.rbegin(); it != graph_ids_map_forward.rend(); ++it) {
+      nchildren += mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
+    }
+    #ifndef GBOLT_SERIAL
+    #pragma omp taskwait
+    #endif
+    return nchildren;
+  }
+  for (auto it = child_graphs_backward.begin(); it != child_graphs_backward.end(); ++it) {
+    nchildren += mine_child(projection, right_most_path, it->first, it->second.graph_ids,
+      dfs_codes, prev_thread_id, prev_graph_id);
+  }
+  for (auto it = child_graphs_forward.rbegin(); it != child_graphs_forward.rend(); ++it) {
+    nchildren += mine_child(projection, right_most_path, it->first, it->second.graph_ids,
+      dfs_codes, prev_thread_id, prev_graph_id);
+  }
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskwait
+  #endif
+  return nchildren;
+}
+
+template <typename W>
+bool GBoltCore<W>::mine_child(
   const Projection &projection,
+  const dfs_code_t& next_code,
+  DfsCodes &dfs_codes,
+  int prev_thread_id,
+  int prev_graph_id) {
+  // Partial pruning, like apriori
+  const int nsupport = mni_support_ > 0 ?
+    count_mni(projection, dfs_codes, next_code) : count_support(projection);
+  if (nsupport < nsupport_) {
+    return false;
+  }
+  // Descendants are supported by at most as many graphs of the target class,
+  // which bounds their score
+  int ntarget = 0;
+  int nother = 0;
+  if (classes()) {
+    count_classes(projection, ntarget, nother);
+    if (ntarget < target_nsupport_) {
+      return false;
+    }
+  }
+  progress_spawned(dfs_codes.size() + 1);
+  #ifndef GBOLT_SERIAL
+  #pragma omp task shared(projection, prev_thread_id, prev_graph_id, nsupport) firstprivate(dfs_codes, ntarget, nother)
+  #endif
+  {
+    const int64_t start = trace_ ? Trace::now() : 0;
+    dfs_codes.emplace_back(&next_code);
+    gbolt_instance_t& instance = thread_instance();
+    const bool is_min = instance.is_min(dfs_codes);
+    int nchildren = 0;
+    if (is_min) {
+      nchildren = mine_pattern(projection, dfs_codes, nsupport, ntarget, nother,
+        prev_thread_id, prev_graph_id);
+    }
+    if (trace_) {
+      // Tied tasks resume on the thread they started on
+      instance.trace.push_back(trace_event_t(start, Trace::now(), dfs_codes.size(),
+        projection.size(), nsupport, nchildren, is_min));
+    }
+    progress_finished(dfs_codes.size());
+    #ifdef GBOLT_SERIAL
+    dfs_codes.pop_back();
+    #endif
+  }
+  return true;
+}
+
+template <typename W>
+bool GBoltCore<W>::mine_child(
+  const Projection &projection,
+  const std::vector<int> &right_most_path,
+  const dfs_code_t& next_code,
+  const std::vector<int> &graph_ids,
+  DfsCodes &dfs_codes,
+  int prev_thread_id,
+  int prev_graph_id) {
+  // Partial pruning, like apriori
+  const int nsupport = count_support(graph_ids);
+  if (nsupport < nsupport_) {
+    return false;
+  }
+  int ntarget = 0;
+  int nother = 0;
+  if (classes()) {
+    count_classes(graph_ids, ntarget, nother);
+    if (ntarget < target_nsupport_) {
+      return false;
+    }
+  }
+  progress_spawned(dfs_codes.size() + 1);
+  #ifndef GBOLT_SERIAL
+  #pragma omp task shared(projection, right_most_path, next_code, graph_ids) firstprivate(dfs_codes, nsupport, ntarget, nother, prev_thread_id, prev_graph_id)
+  #endif
+  {
+    const int64_t start = trace_ ? Trace::now() : 0;
+    dfs_codes.emplace_back(&next_code);
+    gbolt_instance_t& instance = thread_instance();
+    const bool is_min = instance.is_min(dfs_codes);
+    int nchildren = 0;
+    size_t nembeddings = 0;
+    if (is_min) {
+      Projection child;
+      materialize(dfs_codes, projection, right_most_path, graph_ids, child);
+      nembeddings = child.size();
+      nchildren = mine_pattern(child, dfs_codes, nsupport, ntarget, nother,
+        prev_thread_id, prev_graph_id);
+    }
+    if (trace_) {
+      instance.trace.push_back(trace_event_t(start, Trace::now(), dfs_codes.size(),
+        nembeddings, nsupport, nchildren, is_min));
+    }
+    progress_finished(dfs_codes.size());
+    #ifdef GBOLT_SERIAL
+    dfs_codes.pop_back();
+    #endif
+  }
+  return true;
+}
+
+template <typename W>
+int GBoltCore<W>::mine_pattern(
+  const Projection &projection,
+  DfsCodes &dfs_codes,
+  int nsupport,
+  int ntarget,
+  int nother,
+  int prev_thread_id,
+  int prev_graph_id) {
+  gbolt_instance_t& instance = thread_instance();
+  if (collect_) {
+    instance.collect(dfs_codes, projection);
+  } else if (!classes() || discriminative(ntarget, nother)) {
+    instance.report(dfs_codes, projection, nsupport, prev_thread_id, prev_graph_id);
+    prev_thread_id = thread_id();
+    prev_graph_id = instance.output.size() - 1;
+  }
+  return mine_subgraph(projection, dfs_codes, prev_thread_id, prev_graph_id);
+}
+
+template <typename W>
+bool GBoltCore<W>::switch_embedding_free(const Projection &projection) const {
+  return embedding_threshold_ > 0.0 &&
+    projection.size() > embedding_threshold_ * projection.runs().size();
+}
+
+template <typename W>
+int GBoltCore<W>::mine_subgraph(
+  const std::vector<int> &graph_ids,
   DfsCodes &dfs_codes) {
   gbolt_instance_t& instance = thread_instance();
 
   const int prev_thread_id = thread_id();
   const int prev_graph_id = instance.output.size() - 1;
 
-  // Enumerate backward paths and forward paths by different rules
-  ProjectionMapBackward projection_map_backward;
-  ProjectionMapForward projection_map_forward;
-  enumerate(dfs_codes, projection, instance.right_most_path,
-    projection_map_backward, projection_map_forward);
-  // Recursive mining: first backward, last backward, and then last forward to the first forward
-  for (auto it = projection_map_backward.begin(); it != projection_map_backward.end(); ++it) {
-    mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
+  // Re-embed the pattern into one graph at a time, so that only the
+  // embeddings of a single graph are alive
+  GraphIdsMapBackward graph_ids_map_backward;
+  GraphIdsMapForward graph_ids_map_forward;
+  std::vector<Projection> levels(dfs_codes.size());
+  for (auto graph_id : graph_ids) {
+    embed(dfs_codes, graphs_[graph_id], levels);
+
+    // Only the extensions of the graph are needed, not their embeddings
+    ChildGraphsMapBackward child_graphs_backward;
+    ChildGraphsMapForward child_graphs_forward;
+    enumerate(dfs_codes, levels.back(), instance.right_most_path,
+      child_graphs_backward, child_graphs_forward);
+    for (const auto& kv_pair : child_graphs_backward) {
+      graph_ids_map_backward[kv_pair.first].push_back(graph_id);
+    }
+    for (const auto& kv_pair : child_graphs_forward) {
+      graph_ids_map_forward[kv_pair.first].push_back(graph_id);
+    }
+  }
+  levels.clear();
+
+  int nchildren = 0;
+  for (auto it = graph_ids_map_backward.begin(); it != graph_ids_map_backward.end(); ++it) {
+    nchildren += mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
   }
-  for (auto it = projection_map_forward.rbegin(); it != projection_map_forward.rend(); ++it) {
-    mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
+  for (auto it = graph_ids_map_forward.rbegin(); it != graph_ids_map_forward.rend(); ++it) {
+    nchildren += mine_child(it->second, it->first, dfs_codes, prev_thread_id, prev_graph_id);
   }
   #ifndef GBOLT_SERIAL
   #pragma omp taskwait
   #endif
+  return nchildren;
 }
 
-void GBolt::mine_child(
-  const Projection &projection,
+template <typename W>
+bool GBoltCore<W>::mine_child(
+  const std::vector<int> &graph_ids,
   const dfs_code_t& next_code,
   DfsCodes &dfs_codes,
   int prev_thread_id,
   int prev_graph_id) {
-  // Partial pruning, like apriori
-  const int nsupport = count_support(projection);
+  const int nsupport = count_support(graph_ids);
   if (nsupport < nsupport_) {
-    return;
+    return false;
   }
+  progress_spawned(dfs_codes.size() + 1);
   #ifndef GBOLT_SERIAL
-  #pragma omp task shared(projection, prev_thread_id, prev_graph_id, nsupport) firstprivate(dfs_codes)
+  #pragma omp task shared(graph_ids, prev_thread_id, prev_graph_id, nsupport) firstprivate(dfs_codes)
   #endif
   {
+    const int64_t start = trace_ ? Trace::now() : 0;
     dfs_codes.emplace_back(&next_code);
     gbolt_instance_t& instance = thread_instance();
-    if (instance.is_min(dfs_codes)) {
-      instance.report(dfs_codes, projection, nsupport, prev_thread_id, prev_graph_id);
-      mine_subgraph(projection, dfs_codes);
+    const bool is_min = instance.is_min(dfs_codes);
+    int nchildren = 0;
+    if (is_min) {
+      instance.report(dfs_codes, graph_ids, nsupport, prev_thread_id, prev_graph_id);
+      nchildren = mine_subgraph(graph_ids, dfs_codes);
     }
+    if (trace_) {
+      instance.trace.push_back(trace_event_t(start, Trace::now(), dfs_codes.size(),
+        0, nsupport, nchildren, is_min));
+    }
+    progress_finished(dfs_codes.size());
     #ifdef GBOLT_SERIAL
     dfs_codes.pop_back();
     #endif
   }
+  return true;
 }
 
+#define GBOLT_INSTANTIATE(W) \
+  template void basic_gbolt_instance_t<W>::report_graph_ids(const std::vector<int> &, \
+    std::stringstream &); \
+  template void basic_gbolt_instance_t<W>::report(const DfsCodes &, const std::vector<int> &, \
+    int, int, int); \
+  template void GBoltCore<W>::save(bool, bool, bool); \
+  template void GBoltCore<W>::save_trace(const std::string &) const; \
+  template bool GBoltCore<W>::mine_child(const Projection &, const dfs_code_t &, DfsCodes &, \
+    int, int); \
+  template bool GBoltCore<W>::mine_child(const Projection &, const std::vector<int> &, \
+    const dfs_code_t &, const std::vector<int> &, DfsCodes &, int, int); \
+  template bool GBoltCore<W>::mine_child(const std::vector<int> &, const dfs_code_t &, \
+    DfsCodes &, int, int);
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
 }  // namespace gbolt
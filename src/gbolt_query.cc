@@ -0,0 +1,289 @@
+#include <gbolt.h>
+#include <common.h>
+#include <input.h>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <unordered_map>
+
+namespace gbolt {
+
+// A query pattern as read from an output file
+struct query_t {
+  // Vertex and edge lines, with the original labels
+  std::string text;
+  GastonPattern pattern;
+  // False if a label is missing from the input, then nothing supports it
+  bool known = true;
+};
+
+static void read_queries(const std::string &query_file,
+  const std::vector<int> &vertex_labels, const std::vector<int> &edge_labels,
+  std::vector<query_t> &queries) {
+  std::unordered_map<int, int> vertex_label_ids;
+  for (size_t i = 0; i < vertex_labels.size(); ++i) {
+    vertex_label_ids[vertex_labels[i]] = i;
+  }
+  std::unordered_map<int, int> edge_label_ids;
+  for (size_t i = 0; i < edge_labels.size(); ++i) {
+    edge_label_ids[edge_labels[i]] = i;
+  }
+
+  InputReader reader(query_file);
+  std::string line;
+  while (reader.getline(line)) {
+    const std::string text = line + '\n';
+    char *pch = strtok(&line[0], " ");
+    // Parent, class support and supporting graph lines are ignored
+    if (!pch || *pch == 'x' || *pch == 'p' || *pch == 'c') continue;
+
+    switch (*pch) {
+      case 't':
+        queries.emplace_back();
+        break;
+      case 'v': {
+        if (queries.empty()) {
+          LOG_ERROR("Reading query error! Vertex before t #");
+        }
+        query_t &query = queries.back();
+        const size_t id = atoi(strtok(nullptr, " "));
+        const int label = atoi(strtok(nullptr, " "));
+        if (id != query.pattern.labels.size()) {
+          LOG_ERROR("Reading query error! Vertex ids must be contiguous from 0");
+        }
+        auto it = vertex_label_ids.find(label);
+        query.known = query.known && it != vertex_label_ids.end();
+        query.pattern.labels.push_back(it != vertex_label_ids.end() ? it->second : -1);
+        query.text += text;
+        break;
+      }
+      case 'e': {
+        if (queries.empty()) {
+          LOG_ERROR("Reading query error! Edge before t #");
+        }
+        query_t &query = queries.back();
+        const int from = atoi(strtok(nullptr, " "));
+        const int to = atoi(strtok(nullptr, " "));
+        const int label = atoi(strtok(nullptr, " "));
+        const int nvertice = query.pattern.labels.size();
+        if (from < 0 || to < 0 || from >= nvertice || to >= nvertice || from == to) {
+          LOG_ERROR("Reading query error! Edge %d %d of query %zu", from, to, queries.size() - 1);
+        }
+        auto it = edge_label_ids.find(label);
+        query.known = query.known && it != edge_label_ids.end();
+        query.pattern.edges.push_back(gaston_edge_t{from, to,
+          it != edge_label_ids.end() ? it->second : -1});
+        query.text += text;
+        break;
+      }
+      default:
+        LOG_ERROR("Reading query error!");
+    }
+  }
+}
+
+// True iff every vertex of pattern is reachable from the first one
+static bool connected(const GastonPattern &pattern) {
+  const int nvertice = pattern.labels.size();
+  std::vector<int> parents(nvertice);
+  for (int i = 0; i < nvertice; ++i) {
+    parents[i] = i;
+  }
+  std::function<int(int)> find = [&](int vertex) {
+    return parents[vertex] == vertex ? vertex : parents[vertex] = find(parents[vertex]);
+  };
+  int ncomponents = nvertice;
+  for (const auto& edge : pattern.edges) {
+    const int from = find(edge.from);
+    const int to = find(edge.to);
+    if (from != to) {
+      parents[from] = to;
+      --ncomponents;
+    }
+  }
+  return ncomponents == 1;
+}
+
+template <typename W>
+void GBoltCore<W>::execute_query() {
+  #ifdef GBOLT_PERFORMANCE
+  struct timeval time_start, time_end;
+  double elapsed = 0.0;
+  CPU_TIMER_START(elapsed, time_start);
+  #endif
+
+  init_instances();
+
+  std::vector<query_t> queries;
+  read_queries(query_file_, frequent_vertex_labels_, frequent_edge_labels_, queries);
+  query_graph_ids_.assign(queries.size(), std::vector<int>());
+
+  // Queries are inserted by their minimum DFS codes, which are the codes
+  // enumerate extends, and isomorphic queries end at the same node
+  query_nodes_.assign(1, query_node_t());
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const GastonPattern &pattern = queries[i].pattern;
+    if (pattern.labels.empty() || !connected(pattern)) {
+      LOG_ERROR("Query %zu is not a connected pattern", i);
+    }
+    if (!queries[i].known) {
+      continue;
+    }
+    if (pattern.edges.empty()) {
+      // Like the projections, only representatives of duplicate graphs are kept
+      for (auto graph_id : frequent_vertex_graphs_[pattern.labels[0]]) {
+        if (graph_weights_.empty() || graph_weights_[graph_id] != 0) {
+          query_graph_ids_[i].push_back(graph_id);
+        }
+      }
+      continue;
+    }
+    insert_query(pattern.min_dfs_codes(), i);
+  }
+
+  #ifdef GBOLT_PERFORMANCE
+  CPU_TIMER_END(elapsed, time_start, time_end);
+  LOG_INFO("gbolt read %zu queries into %zu trie nodes time: %f",
+    queries.size(), query_nodes_.size() - 1, elapsed);
+  CPU_TIMER_START(elapsed, time_start);
+  #endif
+
+  count_queries();
+
+  // Results keep the order of the query file. Supports are weighted by the
+  // duplicates of each graph, whose ids are listed too.
+  gbolt_instance_t &instance = gbolt_instances_[0];
+  for (size_t i = 0; i < queries.size(); ++i) {
+    std::stringstream ss;
+    ss << queries[i].text;
+    instance.report_graph_ids(query_graph_ids_[i], ss);
+    std::string key;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      key.push_back(static_cast<char>((i >> shift) & 0xff));
+    }
+    instance.output.push_back(ss.str(), count_support(query_graph_ids_[i]), 0, -1, key);
+  }
+
+  #ifdef GBOLT_PERFORMANCE
+  CPU_TIMER_END(elapsed, time_start, time_end);
+  LOG_INFO("gbolt match queries time: %f", elapsed);
+  #endif
+}
+
+template <typename W>
+void GBoltCore<W>::insert_query(const std::vector<wide_dfs_code_t> &dfs_codes, int query) {
+  if (query_nodes_.empty()) {
+    query_nodes_.emplace_back();
+  }
+  int node = 0;
+  for (const auto& wide_code : dfs_codes) {
+    const dfs_code_t code(wide_code);
+    int child = -1;
+    for (auto id : query_nodes_[node].children) {
+      if (query_nodes_[id].code == code) {
+        child = id;
+        break;
+      }
+    }
+    if (child == -1) {
+      child = query_nodes_.size();
+      query_nodes_[node].children.push_back(child);
+      query_nodes_.emplace_back();
+      query_nodes_.back().code = code;
+    }
+    node = child;
+  }
+  query_nodes_[node].queries.push_back(query);
+}
+
+template <typename W>
+void GBoltCore<W>::count_queries() {
+  if (query_nodes_.empty()) {
+    return;
+  }
+  ProjectionMap projection_map;
+  project(projection_map);
+
+  DfsCodes dfs_codes;
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel
+  #pragma omp single nowait
+  #endif
+  {
+    for (auto child : query_nodes_[0].children) {
+      auto it = projection_map.find(query_nodes_[child].code);
+      if (it == projection_map.end()) {
+        continue;
+      }
+      #ifndef GBOLT_SERIAL
+      #pragma omp task firstprivate(it, dfs_codes, child)
+      #endif
+      {
+        dfs_codes.push_back(&query_nodes_[child].code);
+        query_subgraph(it->second, child, dfs_codes);
+        #ifdef GBOLT_SERIAL
+        dfs_codes.pop_back();
+        #endif
+      }
+    }
+  }
+}
+
+template <typename W>
+void GBoltCore<W>::query_subgraph(
+  const Projection &projection,
+  int node,
+  DfsCodes &dfs_codes) {
+  const query_node_t &query_node = query_nodes_[node];
+  std::vector<int> graph_ids;
+  for (const auto& run : projection.runs()) {
+    graph_ids.push_back(run.id);
+  }
+  for (auto query : query_node.queries) {
+    query_graph_ids_[query] = graph_ids;
+  }
+  // Extensions of an infrequent pattern are infrequent, every pattern is
+  // frequent when querying
+  if (query_node.children.empty() || count_support(projection) < nsupport_) {
+    return;
+  }
+
+  // Tasks running on this thread while waiting overwrite the rightmost path
+  // of the instance
+  gbolt_instance_t& instance = thread_instance();
+  instance.update_right_most_path(dfs_codes, dfs_codes.size());
+  const std::vector<int> right_most_path = instance.right_most_path;
+
+  // Only the children of the trie are materialized, instead of every
+  // extension. Children without embeddings, and the queries below them, have
+  // no supporting graph.
+  for (auto child : query_node.children) {
+    #ifndef GBOLT_SERIAL
+    #pragma omp task shared(projection, graph_ids, right_most_path) firstprivate(dfs_codes, child)
+    #endif
+    {
+      dfs_codes.push_back(&query_nodes_[child].code);
+      Projection child_projection;
+      materialize(dfs_codes, projection, right_most_path, graph_ids, child_projection);
+      if (child_projection.size() != 0) {
+        query_subgraph(child_projection, child, dfs_codes);
+      }
+      #ifdef GBOLT_SERIAL
+      dfs_codes.pop_back();
+      #endif
+    }
+  }
+  #ifndef GBOLT_SERIAL
+  #pragma omp taskwait
+  #endif
+}
+
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::execute_query(); \
+  template void GBoltCore<W>::insert_query(const std::vector<wide_dfs_code_t> &, int); \
+  template void GBoltCore<W>::count_queries();
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
+}  // namespace gbolt
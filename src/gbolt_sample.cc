@@ -0,0 +1,134 @@
+#include <gbolt.h>
+#include <common.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <map>
+
+namespace gbolt {
+
+// Query of a candidate in the trie, and its id once reported
+struct sample_entry_t {
+  int query = -1;
+  int output_id = -1;
+};
+
+using Candidates = std::map<std::vector<wide_dfs_code_t>, sample_entry_t, dfs_codes_less_t>;
+
+template <typename W>
+void GBoltCore<W>::execute_sample() {
+  #ifdef GBOLT_PERFORMANCE
+  struct timeval time_start, time_end;
+  double elapsed = 0.0;
+  CPU_TIMER_START(elapsed, time_start);
+  #endif
+
+  init_instances();
+
+  const int ngraphs = graphs_.size();
+  const int nsupport = nsupport_;
+  const int nsample = std::min(std::max(
+    static_cast<int>(std::lround(ngraphs * sample_)), 1), ngraphs);
+
+  // The same seed always draws the same sample
+  std::vector<int> graph_ids(ngraphs);
+  std::iota(graph_ids.begin(), graph_ids.end(), 0);
+  std::mt19937 generator(sample_seed_);
+  std::shuffle(graph_ids.begin(), graph_ids.end(), generator);
+  sampled_.assign(ngraphs, false);
+  for (int i = 0; i < nsample; ++i) {
+    sampled_[graph_ids[i]] = true;
+  }
+
+  // By the multiplicative Chernoff bound, the support of a frequent pattern
+  // in the sample falls below (1 - epsilon) times the support with
+  // probability at most delta, so mining the sample at that support keeps the
+  // pattern. Small samples would lower it to almost nothing, so they fail with
+  // the sample size delta needs rather than weaken delta.
+  const double bound = 2.0 * std::log(1.0 / sample_delta_);
+  const double expected = support_ * nsample;
+  const double epsilon = std::sqrt(bound / expected);
+  if (epsilon > sample_max_lowering_) {
+    const int needed = static_cast<int>(std::ceil(
+      bound / (support_ * sample_max_lowering_ * sample_max_lowering_) - 1e-9));
+    LOG_ERROR("Sample of %d graphs lowers the support by %f for sample delta %f, more than the sample max lowering %f: it needs %d of the %d graphs, or a larger delta or max lowering",
+      nsample, epsilon, sample_delta_, sample_max_lowering_, needed, ngraphs);
+  }
+  nsupport_ = std::max(static_cast<int>(std::ceil((1.0 - epsilon) * expected - 1e-9)), 1);
+  collect_ = true;
+  project();
+  collect_ = false;
+  sampled_.clear();
+
+  LOG_INFO("gbolt sample %d of %d graphs, epsilon %f, sample support %d",
+    nsample, ngraphs, epsilon, nsupport_);
+
+  #ifdef GBOLT_PERFORMANCE
+  CPU_TIMER_END(elapsed, time_start, time_end);
+  LOG_INFO("gbolt mine sample time: %f", elapsed);
+  CPU_TIMER_START(elapsed, time_start);
+  #endif
+
+  // Candidates of the sample are closed under prefixes, like a lattice
+  Candidates candidates;
+  for (auto& instance : gbolt_instances_) {
+    for (auto& pattern : instance.patterns) {
+      candidates[std::move(pattern.dfs_codes)];
+    }
+    instance.patterns.clear();
+  }
+
+  // Count the candidates as queries in all graphs, sharing the embeddings of
+  // common prefixes. Only children of frequent candidates are materialized.
+  query_nodes_.clear();
+  int ncandidates = 0;
+  for (auto& kv_pair : candidates) {
+    kv_pair.second.query = ncandidates++;
+    insert_query(kv_pair.first, kv_pair.second.query);
+  }
+  query_graph_ids_.assign(ncandidates, std::vector<int>());
+  nsupport_ = nsupport;
+  count_queries();
+
+  // Report in DFS code order from a single thread, so that every parent is
+  // reported before its children and the output is deterministic
+  gbolt_instance_t &instance = gbolt_instances_[0];
+  DfsCodes dfs_codes;
+  for (auto& kv_pair : candidates) {
+    sample_entry_t &entry = kv_pair.second;
+    const std::vector<int> &candidate_graphs = query_graph_ids_[entry.query];
+    const int support = candidate_graphs.size();
+    if (support < nsupport) {
+      continue;
+    }
+    int parent_id = -1;
+    if (kv_pair.first.size() > 1) {
+      parent_id = candidates.find(std::vector<wide_dfs_code_t>(
+        kv_pair.first.begin(), kv_pair.first.end() - 1))->second.output_id;
+    }
+    const std::vector<dfs_code_t> codes(kv_pair.first.begin(), kv_pair.first.end());
+    dfs_codes.clear();
+    for (const auto& code : codes) {
+      dfs_codes.push_back(&code);
+    }
+    entry.output_id = instance.output.size();
+    instance.build_min_graph(dfs_codes);
+    instance.report(dfs_codes, candidate_graphs, support, 0, parent_id);
+  }
+
+  LOG_INFO("gbolt verified %d of %zu candidates, each frequent pattern is missed with probability at most %f",
+    instance.output.size(), candidates.size(), sample_delta_);
+
+  #ifdef GBOLT_PERFORMANCE
+  CPU_TIMER_END(elapsed, time_start, time_end);
+  LOG_INFO("gbolt verify candidates time: %f", elapsed);
+  #endif
+}
+
+#define GBOLT_INSTANTIATE(W) \
+  template void GBoltCore<W>::execute_sample();
+GBOLT_INSTANTIATE_WIDTHS(GBOLT_INSTANTIATE)
+#undef GBOLT_INSTANTIATE
+
+}  // namespace gbolt
@@ -0,0 +1,170 @@
+#include <generator.h>
+#include <common.h>
+#include <algorithm>
+#include <cmath>
+
+namespace gbolt {
+
+// Mix the database seed with a graph id, so that every graph has an
+// independent random stream
+static inline uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static inline void append_int(int64_t value, std::string &buffer) {
+  char digits[24];
+  int size = 0;
+  do {
+    digits[size++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (size > 0) {
+    buffer.push_back(digits[--size]);
+  }
+}
+
+Generator::Generator(const generator_config_t &config) :
+  config_(config), nvertices_(0), nedges_(0) {
+  if (config_.ngraphs < 0 || config_.avg_edges < 1.0 ||
+    config_.nvertex_labels <= 0 || config_.nedge_labels <= 0 ||
+    config_.density < 1.0 || config_.nseeds < 0 || config_.avg_seed_edges < 1.0 ||
+    config_.seed_fraction < 0.0 || config_.seed_fraction > 1.0) {
+    LOG_ERROR("Invalid generator configuration");
+  }
+
+  std::mt19937_64 rng(splitmix64(config_.random_seed));
+  std::poisson_distribution<int> seed_size_dist(config_.avg_seed_edges);
+  std::exponential_distribution<double> weight_dist(1.0);
+
+  // Seeds are connected graphs with the same density as the database,
+  // their weights decide how often each one is planted
+  std::vector<double> weights;
+  seeds_.resize(config_.nseeds);
+  for (auto& seed : seeds_) {
+    const int nedges = std::max(1, seed_size_dist(rng));
+    const int nvertices = std::max(2, static_cast<int>(std::lround(nedges / config_.density)));
+    adjacency_.clear();
+    grow(rng, nvertices, nedges, seed);
+    weights.push_back(weight_dist(rng));
+  }
+  if (!weights.empty()) {
+    seed_dist_ = std::discrete_distribution<int>(weights.begin(), weights.end());
+  }
+}
+
+bool Generator::add_edge(int from, int to, int label, gen_graph_t &graph) {
+  if (from == to) {
+    return false;
+  }
+  const uint64_t key = (static_cast<uint64_t>(std::min(from, to)) << 32) |
+    static_cast<uint32_t>(std::max(from, to));
+  if (!adjacency_.insert(key).second) {
+    return false;
+  }
+  graph.edges.emplace_back(from, to, label);
+  return true;
+}
+
+void Generator::grow(std::mt19937_64 &rng, int nvertices, int nedges, gen_graph_t &graph) {
+  std::uniform_int_distribution<int> vertex_label_dist(0, config_.nvertex_labels - 1);
+  std::uniform_int_distribution<int> edge_label_dist(0, config_.nedge_labels - 1);
+
+  // New vertices hang off a random existing vertex, keeping the graph connected
+  while (static_cast<int>(graph.labels.size()) < nvertices) {
+    const int to = graph.labels.size();
+    graph.labels.push_back(vertex_label_dist(rng));
+    if (to > 0) {
+      std::uniform_int_distribution<int> vertex_dist(0, to - 1);
+      add_edge(vertex_dist(rng), to, edge_label_dist(rng), graph);
+    }
+  }
+
+  // Close random cycles, giving up on (nearly) complete graphs
+  const int64_t nvertice = graph.labels.size();
+  const int64_t max_edges = nvertice * (nvertice - 1) / 2;
+  const int64_t target = std::min(static_cast<int64_t>(nedges), max_edges);
+  std::uniform_int_distribution<int> vertex_dist(0, nvertice - 1);
+  int64_t attempts = 4 * (target - static_cast<int64_t>(graph.edges.size())) + 64;
+  while (static_cast<int64_t>(graph.edges.size()) < target && attempts-- > 0) {
+    add_edge(vertex_dist(rng), vertex_dist(rng), edge_label_dist(rng), graph);
+  }
+}
+
+void Generator::generate_graph(int64_t id, gen_graph_t &graph) {
+  std::mt19937_64 rng(splitmix64(config_.random_seed ^ splitmix64(id)));
+  std::poisson_distribution<int> size_dist(config_.avg_edges);
+  std::uniform_int_distribution<int> edge_label_dist(0, config_.nedge_labels - 1);
+
+  graph.labels.clear();
+  graph.edges.clear();
+  adjacency_.clear();
+
+  const int nedges = std::max(1, size_dist(rng));
+  const int nvertices = std::max(2, static_cast<int>(std::lround(nedges / config_.density)));
+
+  // Plant seed copies until they cover the requested fraction of the graph
+  const double planted_edges = config_.seed_fraction * nedges;
+  while (!seeds_.empty() && graph.edges.size() < planted_edges) {
+    const gen_graph_t &seed = seeds_[seed_dist_(rng)];
+    const int offset = graph.labels.size();
+    graph.labels.insert(graph.labels.end(), seed.labels.begin(), seed.labels.end());
+    for (const auto& edge : seed.edges) {
+      add_edge(edge.from + offset, edge.to + offset, edge.label, graph);
+    }
+    if (offset > 0) {
+      std::uniform_int_distribution<int> from_dist(0, offset - 1);
+      std::uniform_int_distribution<int> to_dist(0, seed.labels.size() - 1);
+      add_edge(from_dist(rng), to_dist(rng) + offset, edge_label_dist(rng), graph);
+    }
+  }
+
+  // Pad with random vertices and edges
+  grow(rng, nvertices, nedges, graph);
+}
+
+void Generator::write_graph(int64_t id, const gen_graph_t &graph, std::string &buffer) {
+  buffer.append("t # ");
+  append_int(id, buffer);
+  buffer.push_back('\n');
+  for (size_t i = 0; i < graph.labels.size(); ++i) {
+    buffer.append("v ");
+    append_int(i, buffer);
+    buffer.push_back(' ');
+    append_int(graph.labels[i], buffer);
+    buffer.push_back('\n');
+  }
+  for (const auto& edge : graph.edges) {
+    buffer.append("e ");
+    append_int(edge.from, buffer);
+    buffer.push_back(' ');
+    append_int(edge.to, buffer);
+    buffer.push_back(' ');
+    append_int(edge.label, buffer);
+    buffer.push_back('\n');
+  }
+  nvertices_ += graph.labels.size();
+  nedges_ += graph.edges.size();
+}
+
+void Generator::write(std::ostream &out) {
+  const size_t flush_size = 1 << 20;
+  std::string buffer;
+  buffer.reserve(2 * flush_size);
+  gen_graph_t graph;
+
+  for (int64_t id = 0; id < config_.ngraphs; ++id) {
+    generate_graph(id, graph);
+    write_graph(id, graph, buffer);
+    if (buffer.size() >= flush_size) {
+      out.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+  out.write(buffer.data(), buffer.size());
+  out.flush();
+}
+
+}  // namespace gbolt
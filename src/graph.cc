@@ -0,0 +1,44 @@
+#include <graph.h>
+
+namespace gbolt {
+
+const uint32_t Projection::npos;
+
+template <typename W>
+void BasicGraph<W>::build_edges(const std::vector<edge_t> &undirected_edges) {
+  // Counting sort by the vertex each directed edge leaves, which keeps the
+  // input order within every vertex
+  std::vector<uint32_t> offsets(vertice.size() + 1, 0);
+  for (const auto& edge : undirected_edges) {
+    ++offsets[edge.from + 1];
+    ++offsets[edge.to + 1];
+  }
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    offsets[i] += offsets[i - 1];
+  }
+
+  edges.clear();
+  edges.resize(2 * undirected_edges.size(), edge_t(0, 0, 0, 0));
+  std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+  for (const auto& edge : undirected_edges) {
+    edges[next[edge.from]++] = edge_t(edge.from, edge.label, edge.to, edge.id);
+    edges[next[edge.to]++] = edge_t(edge.to, edge.label, edge.from, edge.id);
+  }
+
+  // Sort by (edge label, to vertex label), so that kernels can skip straight
+  // to the first edge that can extend a DFS code. Ties keep the input order.
+  auto edge_less = [this](const edge_t &first, const edge_t &second) {
+    return first.label < second.label || (first.label == second.label &&
+      vertice[first.to].label < vertice[second.to].label);
+  };
+  for (size_t i = 0; i < vertice.size(); ++i) {
+    std::stable_sort(edges.begin() + offsets[i], edges.begin() + offsets[i + 1], edge_less);
+    vertice[i].edges = BasicEdgeRange<W>(edges.data() + offsets[i], edges.data() + offsets[i + 1]);
+  }
+  nedges = undirected_edges.size();
+}
+
+template class BasicGraph<narrow_width_t>;
+template class BasicGraph<wide_width_t>;
+
+}  // namespace gbolt
@@ -1,85 +1,102 @@
 #include <history.h>
 #include <graph.h>
-#include <algorithm>
 
 namespace gbolt {
 
-static inline void toggle(bool& b) { b = !b; }
+template <typename W>
+void BasicHistory<W>::build(const Projection &projection, uint32_t index, const Graph &graph) {
 
-void History::build(const prev_dfs_t &start, const Graph &graph) {
+  const edge_t *graph_edges = graph.edges.data();
 
-  if (current == nullptr || cur_graph != &graph) {
-    // No current encoding, encode from scratch
-    std::fill_n(has_edges_, graph.nedges, false);
-    std::fill_n(has_vertice_, graph.vertice.size(), false);
-    edge_size_ = 0;
+  if (current != &projection) {
+    level_size_ = 0;
+    for (auto *cur_projection = &projection; cur_projection != nullptr;
+      cur_projection = cur_projection->parent()) {
+      levels_[level_size_++] = &(*cur_projection)[0];
+    }
+  }
 
-    auto *cur_dfs = &start;
-    do {
-      edges_[edge_size_++] = &(cur_dfs->edge);
-      has_edges_[cur_dfs->edge.id] = true;
-      ++has_vertice_[cur_dfs->edge.from];
-      ++has_vertice_[cur_dfs->edge.to];
+  if (current != &projection || cur_graph != &graph) {
+    // No current encoding, encode from scratch
+    reset();
+
+    auto cur_index = index;
+    for (int level = 0; level < level_size_; ++level) {
+      const auto &cur_dfs = levels_[level][cur_index];
+      const edge_t &edge = graph_edges[cur_dfs.edge];
+      edges_[edge_size_++] = &edge;
+      toggle_edge(edge.id);
+      add_vertex(edge.from);
+      add_vertex(edge.to);
+      cur_index = cur_dfs.prev;
     }
-    while ((cur_dfs = cur_dfs->prev) != nullptr);
 
     cur_graph = &graph;
   }
   else {
-    // Has an encoded projection, assume it is the same size and distinct.
-    // (allows the do-while)
-    // Reuse as much of this as possible.
+    // Has an encoded instance of the same projection, so it is the same size.
+    // Reuse as much of this as possible: instances share everything after the
+    // first level at which they have the same index.
 
-    auto *new_dfs = &start;
-    auto *old_dfs = current;
+    auto new_index = index;
+    auto old_index = current_index;
 
-    int modify_index = 0;
+    int level = 0;
 
     do {
-      edges_[modify_index++] = &(new_dfs->edge);
+      const auto &new_dfs = levels_[level][new_index];
+      const auto &old_dfs = levels_[level][old_index];
+      const edge_t &new_edge = graph_edges[new_dfs.edge];
+      const edge_t &old_edge = graph_edges[old_dfs.edge];
+      edges_[level++] = &new_edge;
 
       // Remove old edge
-      toggle(has_edges_[old_dfs->edge.id]);
-      --has_vertice_[old_dfs->edge.from];
-      --has_vertice_[old_dfs->edge.to];
+      toggle_edge(old_edge.id);
+      remove_vertex(old_edge.from);
+      remove_vertex(old_edge.to);
 
       // Add new edge
-      toggle(has_edges_[new_dfs->edge.id]);
-      ++has_vertice_[new_dfs->edge.from];
-      ++has_vertice_[new_dfs->edge.to];
+      toggle_edge(new_edge.id);
+      add_vertex(new_edge.from);
+      add_vertex(new_edge.to);
+
+      new_index = new_dfs.prev;
+      old_index = old_dfs.prev;
     }
-    // As the code lengths are the same, this will also catch the case
-    // where new_dfs and old_dfs end up as nullptr at the same time.
-    while((new_dfs = new_dfs->prev) != (old_dfs = old_dfs->prev));
+    while (level < level_size_ && new_index != old_index);
   }
-  current = &start;
+  current = &projection;
+  current_index = index;
 }
 
-void History::build_edges_min(const MinProjection &projection, const Graph &graph, int start) {
-  std::fill_n(has_edges_, graph.nedges, false);
-  edge_size_ = 0;
+template <typename W>
+void BasicHistory<W>::build_edges_min(const MinProjection &projection, int start) {
+  reset();
 
   do {
     auto &cur_dfs = projection[start];
     edges_[edge_size_++] = &(cur_dfs.edge);
-    has_edges_[cur_dfs.edge.id] = 1;
+    toggle_edge(cur_dfs.edge.id);
     start = cur_dfs.prev;
   }
   while (start != -1);
 }
 
-void History::build_vertice_min(const MinProjection &projection, const Graph &graph, int start) {
-  std::fill_n(has_vertice_, graph.vertice.size(), 0);
-  edge_size_ = 0;
+template <typename W>
+void BasicHistory<W>::build_vertice_min(const MinProjection &projection, int start) {
+  reset();
 
   do {
     auto &cur_dfs = projection[start];
     edges_[edge_size_++] = &(cur_dfs.edge);
-    has_vertice_[cur_dfs.edge.from] = 1;
-    has_vertice_[cur_dfs.edge.to] = 1;
+    add_vertex(cur_dfs.edge.from);
+    add_vertex(cur_dfs.edge.to);
     start = cur_dfs.prev;
   }
   while (start != -1);
 }
 
+template class BasicHistory<narrow_width_t>;
+template class BasicHistory<wide_width_t>;
+
 }  // namespace gbolt
@@ -0,0 +1,239 @@
+#include <input.h>
+#include <common.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef GBOLT_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef GBOLT_ZSTD
+#include <zstd.h>
+#endif
+
+namespace gbolt {
+
+// Size of the blocks read and decoded at once, and the number of decoded
+// blocks the reader thread may run ahead of the parser
+static const size_t block_size = 1 << 20;
+static const size_t queue_size = 4;
+
+static const char gzip_magic[] = {'\x1f', '\x8b'};
+static const char zstd_magic[] = {'\x28', '\xb5', '\x2f', '\xfd'};
+
+InputReader::InputReader(const std::string &input_file) :
+  magic_pos_(0), done_(false), stop_(false), pos_(0) {
+  file_ = input_file == "-" ? stdin : fopen(input_file.c_str(), "rb");
+
+  if (file_ == nullptr) {
+    LOG_ERROR("Open file error! %s", input_file.c_str());
+  }
+
+  // Keep the magic bytes, they are decoded with the rest of the input
+  char magic[sizeof(zstd_magic)];
+  magic_.assign(magic, fread(magic, 1, sizeof(magic), file_));
+  thread_ = std::thread(&InputReader::read, this);
+}
+
+InputReader::~InputReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  not_full_.notify_one();
+  thread_.join();
+  if (file_ != stdin) {
+    fclose(file_);
+  }
+}
+
+bool InputReader::getline(std::string &line) {
+  line.clear();
+  while (true) {
+    if (pos_ == block_.size() && !next_block()) {
+      return !line.empty();
+    }
+    const char *begin = block_.data() + pos_;
+    const char *end = block_.data() + block_.size();
+    const char *newline = static_cast<const char *>(memchr(begin, '\n', end - begin));
+    if (newline != nullptr) {
+      line.append(begin, newline);
+      pos_ = newline - block_.data() + 1;
+      return true;
+    }
+    // The line continues in the next block
+    line.append(begin, end);
+    pos_ = block_.size();
+  }
+}
+
+bool InputReader::next_block() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_empty_.wait(lock, [this] { return !blocks_.empty() || done_; });
+  if (blocks_.empty()) {
+    if (!error_.empty()) {
+      LOG_ERROR("Reading input error! %s", error_.c_str());
+    }
+    return false;
+  }
+  block_ = std::move(blocks_.front());
+  blocks_.pop_front();
+  pos_ = 0;
+  not_full_.notify_one();
+  return true;
+}
+
+bool InputReader::push(std::string &&block) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_full_.wait(lock, [this] { return blocks_.size() < queue_size || stop_; });
+  if (stop_) {
+    return false;
+  }
+  blocks_.push_back(std::move(block));
+  not_empty_.notify_one();
+  return true;
+}
+
+void InputReader::finish(const std::string &error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_ = true;
+  error_ = error;
+  not_empty_.notify_one();
+}
+
+size_t InputReader::read_raw(char *buffer, size_t size) {
+  size_t nread = 0;
+  if (magic_pos_ < magic_.size()) {
+    nread = std::min(size, magic_.size() - magic_pos_);
+    memcpy(buffer, magic_.data() + magic_pos_, nread);
+    magic_pos_ += nread;
+  }
+  return nread + fread(buffer + nread, 1, size - nread, file_);
+}
+
+void InputReader::read() {
+  if (magic_.compare(0, sizeof(gzip_magic), gzip_magic, sizeof(gzip_magic)) == 0) {
+    read_gzip();
+  } else if (magic_.compare(0, sizeof(zstd_magic), zstd_magic, sizeof(zstd_magic)) == 0) {
+    read_zstd();
+  } else {
+    read_plain();
+  }
+}
+
+void InputReader::read_plain() {
+  while (true) {
+    std::string block(block_size, '\0');
+    block.resize(read_raw(&block[0], block_size));
+    if (block.empty() || !push(std::move(block))) {
+      break;
+    }
+  }
+  finish(ferror(file_) ? "I/O error" : "");
+}
+
+void InputReader::read_gzip() {
+  #ifdef GBOLT_ZLIB
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Accept gzip and zlib headers
+  if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+    finish("Cannot initialize zlib");
+    return;
+  }
+  std::vector<char> in(block_size);
+  // Whether the last member ended, only decoding into a member clears it
+  bool ended = false;
+  bool stopped = false;
+  size_t nread;
+  while (!stopped && (nread = read_raw(in.data(), in.size())) > 0) {
+    stream.next_in = reinterpret_cast<Bytef *>(in.data());
+    stream.avail_in = nread;
+    // A full output block may leave decoded data behind
+    bool full = false;
+    while (stream.avail_in > 0 || full) {
+      std::string block(block_size, '\0');
+      stream.next_out = reinterpret_cast<Bytef *>(&block[0]);
+      stream.avail_out = block_size;
+      int ret = inflate(&stream, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        inflateEnd(&stream);
+        finish("Corrupt gzip input");
+        return;
+      }
+      full = stream.avail_out == 0;
+      block.resize(block_size - stream.avail_out);
+      if (!block.empty() && !push(std::move(block))) {
+        stopped = true;
+        break;
+      }
+      if (ret == Z_STREAM_END) {
+        // The member is flushed, concatenated members may follow in the input
+        ended = true;
+        full = false;
+        inflateReset(&stream);
+      } else if (ret == Z_OK) {
+        ended = false;
+      } else {
+        // No progress, more input is needed
+        break;
+      }
+    }
+  }
+  inflateEnd(&stream);
+  finish(ended || stopped ? "" : "Truncated gzip input");
+  #else
+  finish("Gzip input needs a build with zlib");
+  #endif
+}
+
+void InputReader::read_zstd() {
+  #ifdef GBOLT_ZSTD
+  ZSTD_DStream *stream = ZSTD_createDStream();
+  ZSTD_initDStream(stream);
+  std::vector<char> in(ZSTD_DStreamInSize());
+  // Whether the last frame ended, only decoding into a frame clears it
+  bool ended = false;
+  bool stopped = false;
+  size_t nread;
+  while (!stopped && (nread = read_raw(in.data(), in.size())) > 0) {
+    ZSTD_inBuffer input = {in.data(), nread, 0};
+    // A full output block may leave decoded data behind
+    bool full = false;
+    while (input.pos < input.size || full) {
+      std::string block(block_size, '\0');
+      ZSTD_outBuffer output = {&block[0], block.size(), 0};
+      const size_t pos = input.pos;
+      // Zero once a frame is complete and flushed
+      size_t ret = ZSTD_decompressStream(stream, &output, &input);
+      if (ZSTD_isError(ret)) {
+        ZSTD_freeDStream(stream);
+        finish(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(ret));
+        return;
+      }
+      full = output.pos == output.size;
+      const bool progress = input.pos != pos || output.pos != 0;
+      block.resize(output.pos);
+      if (!block.empty() && !push(std::move(block))) {
+        stopped = true;
+        break;
+      }
+      if (ret == 0) {
+        ended = true;
+        full = false;
+      } else if (progress) {
+        ended = false;
+      } else {
+        break;
+      }
+    }
+  }
+  ZSTD_freeDStream(stream);
+  finish(ended || stopped ? "" : "Truncated zstd input");
+  #else
+  finish("Zstd input needs a build with zstd");
+  #endif
+}
+
+}  // namespace gbolt
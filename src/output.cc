@@ -1,5 +1,17 @@
 #include <output.h>
+#include <common.h>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef GBOLT_SERIAL
+#include <omp.h>
+#endif
 
 namespace gbolt {
 
@@ -15,10 +27,25 @@ void Output::push_back(const std::string &str, int nsupport, int thread_id, int
   parent_id_.push_back(parent_id);
 }
 
+void Output::push_back(const std::string &str, int nsupport, int thread_id, int parent_id,
+  const std::string &key) {
+  push_back(str, nsupport, thread_id, parent_id);
+  if (keep_keys_) {
+    keys_.push_back(key);
+  }
+}
+
 void Output::save(bool output_parent, bool output_pattern) {
-  std::ofstream out(output_file_);
+  save(output_file_, output_parent, output_pattern, 0);
+}
+
+void Output::save(const std::string &output_file, bool output_parent, bool output_pattern,
+  int nsupport) const {
+  std::ofstream out(output_file);
 
   for (std::size_t i = 0; i < buffer_.size(); ++i) {
+    if (support_[i] < nsupport)
+      continue;
     out << "t # " << i << " * " << support_[i] << '\n';
     if (output_parent) {
       if (parent_id_[i] == -1)
@@ -32,4 +59,209 @@ void Output::save(bool output_parent, bool output_pattern) {
   }
 }
 
+// Results formatted by each parallel task of save_merged
+static const size_t merge_chunk_size = 1 << 12;
+
+// Ranges of keys merged by each thread in save_merged, and keys sampled per
+// range to find their splitters
+static const size_t merge_ranges_per_thread = 4;
+static const size_t merge_samples_per_range = 64;
+
+void Output::save_merged(const std::vector<const Output *> &outputs,
+  const std::string &output_file, bool output_parent, bool output_pattern, int nsupport,
+  size_t parent_key_size) {
+  const int noutputs = outputs.size();
+  for (const auto output : outputs) {
+    if (output->keys_.size() != output->buffer_.size()) {
+      LOG_ERROR("Merging output error! Results were pushed without keys");
+    }
+  }
+
+  // Sort the results of every output by key
+  std::vector<std::vector<int> > orders(noutputs);
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i = 0; i < noutputs; ++i) {
+    const std::vector<std::string> &keys = outputs[i]->keys_;
+    std::vector<int> &order = orders[i];
+    order.resize(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keys](int a, int b) {
+      return keys[a] < keys[b];
+    });
+  }
+
+  // Split the key space into ranges by splitters sampled evenly from the
+  // sorted outputs, so that every range can be merged on its own
+  size_t nresults = 0;
+  for (int i = 0; i < noutputs; ++i) {
+    nresults += orders[i].size();
+  }
+  #ifdef GBOLT_SERIAL
+  const size_t nthreads = 1;
+  #else
+  const size_t nthreads = omp_get_max_threads();
+  #endif
+  const size_t nranges = std::max<size_t>(1,
+    std::min(nthreads * merge_ranges_per_thread, nresults / merge_chunk_size));
+  // Outputs are sampled in proportion to their sizes
+  std::vector<std::string> samples;
+  for (int i = 0; i < noutputs; ++i) {
+    const size_t nkeys = orders[i].size();
+    const size_t nsamples = (nkeys * nranges * merge_samples_per_range + nresults - 1) /
+      std::max<size_t>(nresults, 1);
+    for (size_t j = 1; j <= nsamples; ++j) {
+      samples.push_back(outputs[i]->keys_[orders[i][nkeys * j / (nsamples + 1)]]);
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+  std::vector<std::string> splitters;
+  for (size_t range = 1; range < nranges && !samples.empty(); ++range) {
+    splitters.push_back(samples[samples.size() * range / nranges]);
+  }
+
+  // bounds[i][range] is the first position in orders[i] of the range, whose
+  // results have keys from the previous splitter up to its own
+  const size_t nsplit = splitters.size() + 1;
+  std::vector<std::vector<size_t> > bounds(noutputs);
+  for (int i = 0; i < noutputs; ++i) {
+    const std::vector<std::string> &keys = outputs[i]->keys_;
+    bounds[i].push_back(0);
+    for (const auto& splitter : splitters) {
+      bounds[i].push_back(std::lower_bound(orders[i].begin() + bounds[i].back(), orders[i].end(),
+        splitter, [&keys](int a, const std::string &key) {
+          return keys[a] < key;
+        }) - orders[i].begin());
+    }
+    bounds[i].push_back(orders[i].size());
+  }
+
+  // Ranges start at the prefix sums of their sizes
+  std::vector<size_t> range_offsets(nsplit + 1, 0);
+  for (size_t range = 0; range < nsplit; ++range) {
+    range_offsets[range + 1] = range_offsets[range];
+    for (int i = 0; i < noutputs; ++i) {
+      range_offsets[range + 1] += bounds[i][range + 1] - bounds[i][range];
+    }
+  }
+
+  // Merge every range of the sorted outputs, global ids follow the merged order
+  std::vector<std::vector<int> > global_ids(noutputs);
+  for (int i = 0; i < noutputs; ++i) {
+    global_ids[i].resize(orders[i].size());
+  }
+  std::vector<std::pair<int, int> > merged(nresults);
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (size_t range = 0; range < nsplit; ++range) {
+    using head_t = std::pair<int, size_t>;
+    auto greater = [&](const head_t &a, const head_t &b) {
+      return outputs[a.first]->keys_[orders[a.first][a.second]] >
+        outputs[b.first]->keys_[orders[b.first][b.second]];
+    };
+    std::priority_queue<head_t, std::vector<head_t>, decltype(greater)> heads(greater);
+    for (int i = 0; i < noutputs; ++i) {
+      if (bounds[i][range] < bounds[i][range + 1]) {
+        heads.emplace(i, bounds[i][range]);
+      }
+    }
+    size_t global_id = range_offsets[range];
+    while (!heads.empty()) {
+      const head_t head = heads.top();
+      heads.pop();
+      const int index = orders[head.first][head.second];
+      global_ids[head.first][index] = global_id;
+      merged[global_id++] = std::make_pair(head.first, index);
+      if (head.second + 1 < bounds[head.first][range + 1]) {
+        heads.emplace(head.first, head.second + 1);
+      }
+    }
+  }
+
+  // Merged results are sorted by key, and a parent key sorts before its children
+  auto key_of = [&](size_t global_id) -> const std::string& {
+    return outputs[merged[global_id].first]->keys_[merged[global_id].second];
+  };
+  auto key_parent = [&](size_t global_id) -> int {
+    const std::string &key = key_of(global_id);
+    if (key.size() <= parent_key_size) {
+      return -1;
+    }
+    const std::string prefix = key.substr(0, key.size() - parent_key_size);
+    size_t first = 0, last = global_id;
+    while (first < last) {
+      const size_t middle = first + (last - first) / 2;
+      if (key_of(middle) < prefix) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+    return first < global_id && key_of(first) == prefix ? first : -1;
+  };
+
+  // Format chunks of consecutive results, then write each at its offset
+  const size_t nchunks = (merged.size() + merge_chunk_size - 1) / merge_chunk_size;
+  std::vector<std::string> chunks(nchunks);
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+    std::stringstream ss;
+    const size_t end = std::min(merged.size(), (chunk + 1) * merge_chunk_size);
+    for (size_t global_id = chunk * merge_chunk_size; global_id < end; ++global_id) {
+      const Output &output = *outputs[merged[global_id].first];
+      const int i = merged[global_id].second;
+      if (output.support_[i] < nsupport)
+        continue;
+      ss << "t # " << global_id << " * " << output.support_[i] << '\n';
+      if (output_parent) {
+        const int parent_id = parent_key_size != 0 ? key_parent(global_id) :
+          output.parent_id_[i] == -1 ? -1 :
+          global_ids[output.thread_id_[i]][output.parent_id_[i]];
+        ss << "parent : " << parent_id << '\n';
+      }
+      if (output_pattern) {
+        ss << output.buffer_[i] << '\n';
+      }
+    }
+    chunks[chunk] = ss.str();
+  }
+  std::vector<off_t> offsets(nchunks + 1, 0);
+  for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+    offsets[chunk + 1] = offsets[chunk] + chunks[chunk].size();
+  }
+
+  const int fd = open(output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    LOG_ERROR("Open file error! %s", output_file.c_str());
+  }
+  bool failed = false;
+  #ifndef GBOLT_SERIAL
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (size_t chunk = 0; chunk < nchunks; ++chunk) {
+    const std::string &data = chunks[chunk];
+    size_t written = 0;
+    while (written < data.size()) {
+      const ssize_t nwritten = pwrite(fd, data.data() + written, data.size() - written,
+        offsets[chunk] + written);
+      if (nwritten <= 0) {
+        #ifndef GBOLT_SERIAL
+        #pragma omp atomic write
+        #endif
+        failed = true;
+        break;
+      }
+      written += nwritten;
+    }
+  }
+  close(fd);
+  if (failed) {
+    LOG_ERROR("Write file error! %s", output_file.c_str());
+  }
+}
+
 }  // namespace gbolt
@@ -0,0 +1,128 @@
+#include <progress.h>
+#include <common.h>
+#include <cstdio>
+#include <fstream>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace gbolt {
+
+Monitor::Monitor(const progress_counter_t *counters, int ncounters, double interval,
+  const std::string &status_file) :
+  counters_(counters), ncounters_(ncounters), interval_(interval),
+  status_file_(status_file), stopping_(false), last_patterns_(0) {}
+
+Monitor::~Monitor() {
+  stop();
+}
+
+void Monitor::start() {
+  start_ = last_time_ = std::chrono::steady_clock::now();
+  thread_ = std::thread(&Monitor::run, this);
+}
+
+void Monitor::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+  report(true);
+}
+
+void Monitor::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!condition_.wait_for(lock, interval_, [this] { return stopping_; })) {
+    lock.unlock();
+    report(false);
+    lock.lock();
+  }
+}
+
+void Monitor::report(bool done) {
+  uint64_t patterns = 0;
+  uint64_t tasks_spawned = 0;
+  uint64_t tasks_finished = 0;
+  uint64_t subtrees_spawned = 0;
+  uint64_t subtrees_finished = 0;
+  for (int i = 0; i < ncounters_; ++i) {
+    patterns += counters_[i].patterns.load(std::memory_order_relaxed);
+    tasks_spawned += counters_[i].tasks_spawned.load(std::memory_order_relaxed);
+    tasks_finished += counters_[i].tasks_finished.load(std::memory_order_relaxed);
+    subtrees_spawned += counters_[i].subtrees_spawned.load(std::memory_order_relaxed);
+    subtrees_finished += counters_[i].subtrees_finished.load(std::memory_order_relaxed);
+  }
+  // Counters of different threads are read at slightly different times
+  const uint64_t tasks = tasks_spawned > tasks_finished ? tasks_spawned - tasks_finished : 0;
+
+  const auto now = std::chrono::steady_clock::now();
+  const double elapsed = std::chrono::duration<double>(now - start_).count();
+  const double interval = std::chrono::duration<double>(now - last_time_).count();
+  const double rate = interval > 0.0 ?
+    (patterns - last_patterns_) / interval : 0.0;
+  last_time_ = now;
+  last_patterns_ = patterns;
+  const double rss = resident_memory() / (1024.0 * 1024.0);
+
+  // Subtrees differ wildly in size, so the estimate is only a rough guide
+  char eta[32] = "unknown";
+  if (done) {
+    snprintf(eta, sizeof(eta), "0");
+  } else if (subtrees_finished > 0 && subtrees_finished < subtrees_spawned) {
+    snprintf(eta, sizeof(eta), "%.0f",
+      elapsed / subtrees_finished * (subtrees_spawned - subtrees_finished));
+  }
+
+  if (status_file_.empty()) {
+    LOG_INFO("gbolt progress %s: elapsed %.1f s patterns %llu (%.1f/s) subtrees %llu/%llu tasks %llu rss %.1f MB eta %s s",
+      done ? "done" : "running", elapsed, static_cast<unsigned long long>(patterns), rate,
+      static_cast<unsigned long long>(subtrees_finished),
+      static_cast<unsigned long long>(subtrees_spawned),
+      static_cast<unsigned long long>(tasks), rss, eta);
+    fflush(stdout);
+    return;
+  }
+
+  // Readers never see a partial status
+  const std::string tmp_file = status_file_ + ".tmp";
+  {
+    std::ofstream out(tmp_file);
+    if (!out.is_open()) {
+      return;
+    }
+    out << "state: " << (done ? "done" : "running") << '\n'
+      << "elapsed_seconds: " << elapsed << '\n'
+      << "patterns: " << patterns << '\n'
+      << "patterns_per_second: " << rate << '\n'
+      << "subtrees_finished: " << subtrees_finished << '\n'
+      << "subtrees_total: " << subtrees_spawned << '\n'
+      << "outstanding_tasks: " << tasks << '\n'
+      << "rss_mb: " << rss << '\n'
+      << "eta_seconds: " << eta << '\n';
+  }
+  std::rename(tmp_file.c_str(), status_file_.c_str());
+}
+
+uint64_t Monitor::resident_memory() {
+  #ifdef __linux__
+  // Total and resident pages
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  const int nread = fscanf(file, "%llu %llu", &size, &resident);
+  fclose(file);
+  return nread == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+  #else
+  return 0;
+  #endif
+}
+
+}  // namespace gbolt
@@ -0,0 +1,102 @@
+#include <state.h>
+#include <common.h>
+#include <fstream>
+#include <limits>
+
+namespace gbolt {
+
+static const char *state_magic = "gbolt-state";
+static const int state_version = 1;
+
+static void read_labels(std::ifstream &in, const char *tag, std::vector<int> &labels) {
+  std::string name;
+  size_t nlabels = 0;
+  in >> name >> nlabels;
+  if (name != tag) {
+    LOG_ERROR("Reading state error! Expected %s", tag);
+  }
+  labels.resize(nlabels);
+  for (auto& label : labels) {
+    in >> label;
+  }
+}
+
+static void write_labels(std::ofstream &out, const char *tag, const std::vector<int> &labels) {
+  out << tag << ' ' << labels.size();
+  for (auto label : labels) {
+    out << ' ' << label;
+  }
+  out << '\n';
+}
+
+void state_t::read(const std::string &state_file) {
+  std::ifstream in(state_file);
+
+  if (!in.is_open()) {
+    LOG_ERROR("Open file error! %s", state_file.c_str());
+  }
+
+  std::string magic;
+  int version = 0;
+  in >> magic >> version;
+  if (magic != state_magic || version != state_version) {
+    LOG_ERROR("Reading state error! %s is not a gbolt state", state_file.c_str());
+  }
+
+  std::string tag;
+  in >> tag >> ngraphs >> border >> nborder;
+  read_labels(in, "vl", vertex_labels);
+  read_labels(in, "el", edge_labels);
+
+  size_t npatterns = 0;
+  in >> tag >> npatterns;
+  patterns.resize(npatterns);
+  for (auto& pattern : patterns) {
+    size_t ncodes = 0;
+    size_t ngraph_ids = 0;
+    in >> tag >> ncodes >> ngraph_ids;
+    pattern.dfs_codes.resize(ncodes);
+    for (auto& code : pattern.dfs_codes) {
+      in >> code.from >> code.to >> code.from_label >> code.edge_label >> code.to_label;
+    }
+    pattern.graph_ids.resize(ngraph_ids);
+    for (auto& graph_id : pattern.graph_ids) {
+      in >> graph_id;
+    }
+  }
+
+  if (!in) {
+    LOG_ERROR("Reading state error! %s is truncated", state_file.c_str());
+  }
+}
+
+void state_t::write(const std::string &state_file) const {
+  std::ofstream out(state_file);
+
+  if (!out.is_open()) {
+    LOG_ERROR("Open file error! %s", state_file.c_str());
+  }
+
+  out << state_magic << ' ' << state_version << '\n';
+  // The border is read back exactly
+  out.precision(std::numeric_limits<double>::max_digits10);
+  out << "n " << ngraphs << ' ' << border << ' ' << nborder << '\n';
+  write_labels(out, "vl", vertex_labels);
+  write_labels(out, "el", edge_labels);
+
+  // One line per pattern: its codes, then its graphs
+  out << "p " << patterns.size() << '\n';
+  for (const auto& pattern : patterns) {
+    out << "c " << pattern.dfs_codes.size() << ' ' << pattern.graph_ids.size();
+    for (const auto& code : pattern.dfs_codes) {
+      out << ' ' << code.from << ' ' << code.to << ' ' << code.from_label <<
+        ' ' << code.edge_label << ' ' << code.to_label;
+    }
+    for (auto graph_id : pattern.graph_ids) {
+      out << ' ' << graph_id;
+    }
+    out << '\n';
+  }
+}
+
+}  // namespace gbolt
@@ -0,0 +1,35 @@
+#include <trace.h>
+#include <algorithm>
+#include <limits>
+
+namespace gbolt {
+
+int64_t Trace::start() const {
+  int64_t start = std::numeric_limits<int64_t>::max();
+  for (const auto& event : events_) {
+    start = std::min(start, event.start);
+  }
+  return start;
+}
+
+void Trace::save(std::ostream &out, int tid, int64_t epoch, bool &first) const {
+  // Name the thread track in the viewer
+  out << (first ? "\n" : ",\n");
+  first = false;
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+    << ",\"args\":{\"name\":\"gbolt thread " << tid << "\"}}";
+
+  for (const auto& event : events_) {
+    out << ",\n{\"name\":\"mine d" << event.depth
+      << "\",\"cat\":\"" << (event.is_min ? "task" : "pruned")
+      << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+      << ",\"ts\":" << event.start - epoch
+      << ",\"dur\":" << event.end - event.start
+      << ",\"args\":{\"depth\":" << event.depth
+      << ",\"projection\":" << event.projection_size
+      << ",\"support\":" << event.nsupport
+      << ",\"children\":" << event.nchildren << "}}";
+  }
+}
+
+}  // namespace gbolt
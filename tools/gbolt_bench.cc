@@ -0,0 +1,344 @@
+#include <gbolt.h>
+#include <database.h>
+#include <history.h>
+#include <common.h>
+#include <generator.h>
+#include <cxxopts.hpp>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <new>
+#include <unistd.h>
+
+// Count every heap allocation made by the kernels
+static std::atomic<size_t> nallocs(0);
+
+void *operator new(std::size_t size) {
+  nallocs.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  free(ptr);
+}
+
+namespace gbolt {
+
+class GBoltBench {
+ public:
+  GBoltBench(int warmup, int repeat, int depth) :
+    warmup_(warmup), repeat_(repeat), depth_(depth) {}
+
+  // Run every kernel on a single dataset
+  void run(const std::string &dataset, const std::string &input_file, double support);
+
+  static void print_header();
+
+ private:
+  // The patterns of the first depth_ levels of the search tree of a core,
+  // with their projections
+  template <typename W>
+  struct search_tree_t {
+    using ProjectionMap = typename GBoltCore<W>::ProjectionMap;
+    using ProjectionMapBackward = typename GBoltCore<W>::ProjectionMapBackward;
+    using ProjectionMapForward = typename GBoltCore<W>::ProjectionMapForward;
+
+    struct pattern_t {
+      BasicDfsCodes<W> dfs_codes;
+      const Projection *projection;
+      std::vector<int> right_most_path;
+      bool is_min;
+    };
+
+    ProjectionMap projection_map;
+    std::list<ProjectionMapBackward> projection_maps_backward;
+    std::list<ProjectionMapForward> projection_maps_forward;
+    std::vector<pattern_t> patterns;
+  };
+
+  // Runs kernel() warmup_ times untimed and repeat_ times timed, reporting
+  // nops operations per run
+  template <typename Kernel>
+  void measure(const char *name, const std::string &dataset, size_t nops, Kernel kernel);
+
+  // Collect the patterns of the first depth_ levels of the search tree
+  template <typename W>
+  void collect(GBoltCore<W> &gbolt, search_tree_t<W> &tree);
+
+  // Run the mining kernels on the core read_input chose
+  template <typename W>
+  void run_kernels(const std::string &dataset, GBoltCore<W> &gbolt);
+
+ private:
+  int warmup_;
+  int repeat_;
+  int depth_;
+};
+
+template <typename Kernel>
+void GBoltBench::measure(const char *name, const std::string &dataset, size_t nops, Kernel kernel) {
+  if (nops == 0) {
+    return;
+  }
+  for (auto i = 0; i < warmup_; ++i) {
+    kernel();
+  }
+
+  std::vector<double> ns_per_op;
+  const size_t nallocs_start = nallocs.load(std::memory_order_relaxed);
+  for (auto i = 0; i < repeat_; ++i) {
+    struct timeval time_start, time_end;
+    double elapsed = 0.0;
+    CPU_TIMER_START(elapsed, time_start);
+    kernel();
+    CPU_TIMER_END(elapsed, time_start, time_end);
+    ns_per_op.push_back(elapsed * 1e9 / nops);
+  }
+  const size_t nallocs_end = nallocs.load(std::memory_order_relaxed);
+
+  double mean = 0.0;
+  for (auto ns : ns_per_op) {
+    mean += ns;
+  }
+  mean /= ns_per_op.size();
+  double var = 0.0;
+  for (auto ns : ns_per_op) {
+    var += (ns - mean) * (ns - mean);
+  }
+  const double stddev = ns_per_op.size() > 1 ? std::sqrt(var / (ns_per_op.size() - 1)) : 0.0;
+  const double allocs = static_cast<double>(nallocs_end - nallocs_start) / (nops * repeat_);
+
+  printf("%-16s %-16s %10zu %14.1f %12.1f %12.2f\n",
+    name, dataset.c_str(), nops, mean, stddev, allocs);
+  fflush(stdout);
+}
+
+void GBoltBench::print_header() {
+  printf("%-16s %-16s %10s %14s %12s %12s\n",
+    "kernel", "dataset", "ops/rep", "ns/op", "stddev", "allocs/op");
+}
+
+template <typename W>
+void GBoltBench::collect(GBoltCore<W> &gbolt, search_tree_t<W> &tree) {
+  using pattern_t = typename search_tree_t<W>::pattern_t;
+  auto &instance = gbolt.thread_instance();
+  auto &patterns = tree.patterns;
+
+  gbolt.project(tree.projection_map);
+  size_t level_start = patterns.size();
+  for (const auto& kv_pair : tree.projection_map) {
+    if (gbolt.count_support(kv_pair.second) < gbolt.nsupport_) {
+      continue;
+    }
+    patterns.push_back(pattern_t{BasicDfsCodes<W>{&kv_pair.first}, &kv_pair.second, {}, true});
+  }
+
+  for (auto depth = 1; depth < depth_; ++depth) {
+    const size_t level_end = patterns.size();
+    for (auto i = level_start; i < level_end; ++i) {
+      if (!patterns[i].is_min) {
+        continue;
+      }
+      // Copy, since patterns may grow
+      const BasicDfsCodes<W> dfs_codes = patterns[i].dfs_codes;
+      const Projection &projection = *patterns[i].projection;
+      instance.is_min(dfs_codes);
+      patterns[i].right_most_path = instance.right_most_path;
+
+      tree.projection_maps_backward.emplace_back();
+      tree.projection_maps_forward.emplace_back();
+      gbolt.enumerate(dfs_codes, projection, patterns[i].right_most_path,
+        tree.projection_maps_backward.back(), tree.projection_maps_forward.back());
+
+      auto push_child = [&](const basic_dfs_code_t<W> &dfs_code, const Projection &child) {
+        if (gbolt.count_support(child) < gbolt.nsupport_) {
+          return;
+        }
+        BasicDfsCodes<W> child_codes = dfs_codes;
+        child_codes.push_back(&dfs_code);
+        const bool is_min = instance.is_min(child_codes);
+        patterns.push_back(pattern_t{child_codes, &child, instance.right_most_path, is_min});
+      };
+      for (const auto& kv_pair : tree.projection_maps_backward.back()) {
+        push_child(kv_pair.first, kv_pair.second);
+      }
+      for (const auto& kv_pair : tree.projection_maps_forward.back()) {
+        push_child(kv_pair.first, kv_pair.second);
+      }
+    }
+    level_start = level_end;
+  }
+  // Patterns of the last level still need their rightmost path
+  for (auto i = level_start; i < patterns.size(); ++i) {
+    if (patterns[i].is_min && patterns[i].right_most_path.empty()) {
+      instance.is_min(patterns[i].dfs_codes);
+      patterns[i].right_most_path = instance.right_most_path;
+    }
+  }
+}
+
+void GBoltBench::run(const std::string &dataset, const std::string &input_file, double support) {
+  measure("read_input", dataset, 1, [&]() {
+    Database db;
+    db.read_input(input_file, " ");
+  });
+
+  GBolt gbolt("", support);
+  gbolt.read_input(input_file, " ");
+  if (gbolt.narrow_) {
+    run_kernels(dataset, *gbolt.narrow_);
+  } else {
+    run_kernels(dataset, *gbolt.wide_);
+  }
+}
+
+template <typename W>
+void GBoltBench::run_kernels(const std::string &dataset, GBoltCore<W> &gbolt) {
+  using ProjectionMapBackward = typename search_tree_t<W>::ProjectionMapBackward;
+  using ProjectionMapForward = typename search_tree_t<W>::ProjectionMapForward;
+  gbolt.init_instances();
+  auto &instance = gbolt.thread_instance();
+
+  search_tree_t<W> tree;
+  const auto &patterns = tree.patterns;
+  collect(gbolt, tree);
+
+  size_t nembeddings = 0;
+  size_t nmin = 0;
+  for (const auto& pattern : patterns) {
+    if (pattern.is_min) {
+      nembeddings += pattern.projection->size();
+      ++nmin;
+    }
+  }
+
+  measure("History::build", dataset, nembeddings, [&]() {
+    for (const auto& pattern : patterns) {
+      if (!pattern.is_min) {
+        continue;
+      }
+      const Projection &projection = *pattern.projection;
+      const auto& runs = projection.runs();
+      for (size_t run = 0; run < runs.size(); ++run) {
+        const auto &graph = gbolt.graphs_[runs[run].id];
+        for (auto i = runs[run].begin; i < projection.run_end(run); ++i) {
+          instance.history.build(projection, i, graph);
+        }
+      }
+      instance.history.clear();
+    }
+  });
+
+  measure("is_min", dataset, patterns.size(), [&]() {
+    for (const auto& pattern : patterns) {
+      instance.is_min(pattern.dfs_codes);
+    }
+  });
+
+  measure("enumerate", dataset, nmin, [&]() {
+    for (const auto& pattern : patterns) {
+      if (!pattern.is_min) {
+        continue;
+      }
+      ProjectionMapBackward projection_map_backward;
+      ProjectionMapForward projection_map_forward;
+      gbolt.enumerate(pattern.dfs_codes, *pattern.projection, pattern.right_most_path,
+        projection_map_backward, projection_map_forward);
+    }
+  });
+
+  // Count support is cheap, so repeat it to get measurable times
+  const int count_rounds = 16;
+  volatile int sink = 0;
+  measure("count_support", dataset, patterns.size() * count_rounds, [&]() {
+    for (auto i = 0; i < count_rounds; ++i) {
+      for (const auto& pattern : patterns) {
+        sink = sink + gbolt.count_support(*pattern.projection);
+      }
+    }
+  });
+}
+
+}  // namespace gbolt
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options options("gBolt-bench", "microbenchmarks for the gBolt mining kernels");
+  options.add_options()
+    ("d,data", "Directory of the bundled datasets", cxxopts::value<std::string>()->default_value("extern/data"))
+    ("w,warmup", "Untimed warmup runs per kernel", cxxopts::value<int>()->default_value("2"))
+    ("r,repeat", "Timed runs per kernel", cxxopts::value<int>()->default_value("10"))
+    ("l,levels", "Search tree levels to collect patterns from", cxxopts::value<int>()->default_value("3"))
+    ("g,graphs", "Number of synthetic graphs", cxxopts::value<int>()->default_value("500"))
+    ("h,help", "gBolt-bench help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].count()) {
+    LOG_INFO("%s", options.help().c_str());
+    return 0;
+  }
+
+  const std::string data = result["data"].as<std::string>();
+  const int warmup = result["warmup"].as<int>();
+  const int repeat = result["repeat"].as<int>();
+  const int levels = result["levels"].as<int>();
+  const int ngraphs = result["graphs"].as<int>();
+
+  if (repeat <= 0 || levels <= 0) {
+    LOG_ERROR("Repeat and levels should be greater than 0");
+  }
+
+  // Small graphs with planted patterns, similar in size to the bundled sets,
+  // in a temporary file removed after the run
+  const char *tmpdir = getenv("TMPDIR");
+  std::string synthetic = std::string(tmpdir != nullptr && *tmpdir != '\0' ? tmpdir : "/tmp") +
+    "/gbolt_bench.XXXXXX";
+  const int fd = mkstemp(&synthetic[0]);
+  if (fd < 0) {
+    LOG_ERROR("Open file error! %s", synthetic.c_str());
+  }
+  close(fd);
+  gbolt::generator_config_t config;
+  config.ngraphs = ngraphs;
+  config.avg_edges = 25.0;
+  config.nvertex_labels = 8;
+  config.nedge_labels = 3;
+  config.nseeds = 10;
+  config.random_seed = 42;
+  {
+    std::ofstream out(synthetic);
+    gbolt::Generator(config).write(out);
+  }
+
+  gbolt::GBoltBench bench(warmup, repeat, levels);
+  gbolt::GBoltBench::print_header();
+  bench.run("Compound_422", data + "/Compound_422", 0.1);
+  bench.run("Chemical_340", data + "/Chemical_340", 0.1);
+  bench.run("synthetic", synthetic, 0.1);
+
+  remove(synthetic.c_str());
+  return 0;
+}
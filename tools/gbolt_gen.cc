@@ -0,0 +1,58 @@
+#include <generator.h>
+#include <common.h>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options options("gBolt-gen", "synthetic graph database generator for gBolt");
+  options.add_options()
+    ("o,output", "Output path of graph data, - for stdout", cxxopts::value<std::string>()->default_value("-"))
+    ("D,graphs", "Number of graphs", cxxopts::value<int64_t>()->default_value("1000"))
+    ("T,size", "Average number of edges per graph", cxxopts::value<double>()->default_value("20"))
+    ("V,vertex-labels", "Number of vertex labels", cxxopts::value<int>()->default_value("20"))
+    ("E,edge-labels", "Number of edge labels", cxxopts::value<int>()->default_value("5"))
+    ("d,density", "Average number of edges per vertex: [1.0, inf)", cxxopts::value<double>()->default_value("1.2"))
+    ("L,seeds", "Number of planted frequent seed patterns", cxxopts::value<int>()->default_value("50"))
+    ("I,seed-size", "Average number of edges per seed pattern", cxxopts::value<double>()->default_value("5"))
+    ("f,seed-fraction", "Fraction of edges covered by seeds: [0.0, 1.0]", cxxopts::value<double>()->default_value("0.5"))
+    ("r,random-seed", "Random seed", cxxopts::value<uint64_t>()->default_value("1"))
+    ("h,help", "gBolt-gen help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].count()) {
+    LOG_INFO("%s", options.help().c_str());
+    return 0;
+  }
+
+  gbolt::generator_config_t config;
+  config.ngraphs = result["graphs"].as<int64_t>();
+  config.avg_edges = result["size"].as<double>();
+  config.nvertex_labels = result["vertex-labels"].as<int>();
+  config.nedge_labels = result["edge-labels"].as<int>();
+  config.density = result["density"].as<double>();
+  config.nseeds = result["seeds"].as<int>();
+  config.avg_seed_edges = result["seed-size"].as<double>();
+  config.seed_fraction = result["seed-fraction"].as<double>();
+  config.random_seed = result["random-seed"].as<uint64_t>();
+  const std::string output = result["output"].as<std::string>();
+
+  gbolt::Generator generator(config);
+
+  if (output == "-") {
+    generator.write(std::cout);
+  } else {
+    std::ofstream out(output, std::ios::binary);
+    if (!out.is_open()) {
+      LOG_ERROR("Open file error! %s", output.c_str());
+    }
+    generator.write(out);
+    // Logs go to stdout, so only report when writing to a file
+    LOG_INFO("gbolt-gen wrote %lld graphs, %lld vertices, %lld edges",
+      static_cast<long long>(config.ngraphs),
+      static_cast<long long>(generator.nvertices()),
+      static_cast<long long>(generator.nedges()));
+  }
+  return 0;
+}